@@ -1,22 +1,135 @@
 // Copyright (c) 2023 Trevor Makes
 
+#include "serial.hpp"
+#include "stopwatch.hpp"
 #include "util.hpp"
 
+#include <avr/eeprom.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <setjmp.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/delay.h>
+
+// Production go/no-go: stop at the first failure and report time to verdict
+// Enable with `build_flags = -D SCREEN_MODE=1` in platformio.ini
+#ifndef SCREEN_MODE
+#define SCREEN_MODE 0
+#endif
+
+// Tiered test: 1 = MATS+ pre-screen then March C-, 2 = also escalate to March B
+// Later tiers only run if the earlier ones passed
+#ifndef TIERED_MODE
+#define TIERED_MODE 0
+#endif
+
+// Scheduled refresh with CAS before RAS instead of RAS-only (most 41256, few 4164)
+#ifndef CBR_REFRESH
+#define CBR_REFRESH 0
+#endif
+
+// Run march C- with the fastest access mode the chip supports (page, static
+// column, or nibble) instead of a full RAS cycle for every access
+#ifndef FAST_MODE
+#define FAST_MODE 0
+#endif
+
+// Repeat march C- over checkerboard, row stripe, col stripe and diagonal
+// backgrounds after the solid one, for pattern sensitive faults
+#ifndef MULTI_BACKGROUND
+#define MULTI_BACKGROUND 0
+#endif
+
+// Address order for march C-: 0 = linear, 1 = Gray code, 2 = address
+// complement, 3 = column fast, 4 = pseudo-random (see `Order`)
+// MATS+, march B and the extra sweeps of the modes below stay linear
+#ifndef ADDRESS_ORDER
+#define ADDRESS_ORDER 0
+#endif
+
+// Fast access modes step through columns a page at a time, so they can't
+// follow another address order
+#if ADDRESS_ORDER && FAST_MODE
+#error ADDRESS_ORDER needs FAST_MODE=0
+#endif
+
+// Repeat march C- with address increments of 2, 4, ... 2^15 (then A8 on 41256)
+// after the usual increment of 1, for address decoder delay faults
+#ifndef MOVI_MODE
+#define MOVI_MODE 0
+#endif
+
+// Pseudo-random data: 1 = fill the array from a 32-bit LFSR then read it back,
+// 2 = also in pseudo-random address order; runs after march C- each pass
+#ifndef RANDOM_DATA
+#define RANDOM_DATA 0
+#endif
+
+// Automated handler interface: wait for START, then run this many passes
+// (stopping at the first failure) and signal the verdict on the LED pins
+// Replaces the mode switch with BUSY, so access time measurement is unavailable
+#ifndef FIXTURE_MODE
+#define FIXTURE_MODE 0
+#endif
+
+// Check the CAS before RAS refresh counter covers all rows before testing
+#ifndef CBR_TEST
+#define CBR_TEST 0
+#endif
+
+// Send failing cells during each pass, tagged with the march element, for a
+// die map on the host (see tools/die_map.py)
+#ifndef FAIL_STREAM
+#define FAIL_STREAM 0
+#endif
+
+// Find the shortest RAS precharge (tRP) march C- passes with before testing,
+// starting from this many cycles of delay and taking one cycle off at a time
+#ifndef PRECHARGE_TEST
+#define PRECHARGE_TEST 0
+#endif
+
+// Bin the chip by speed before testing, running march C- with Dout sampled
+// one cycle earlier each time until it fails
+#ifndef SPEED_BIN
+#define SPEED_BIN 0
+#endif
+
+// Test algorithm, as recorded in the fault log
+enum Algorithm : uint8_t { MARCH_C, TIERED_MARCH_C, TIERED_MARCH_B };
+
+// Reports after each pass: FULL adds the failure bitmap and timing to STATS
+enum Format : uint8_t { FULL, BRIEF };
+
+// Settings changed from the serial shell between passes
+// Defaults come from the build flags
+struct Settings {
+  Algorithm algorithm;
+  uint32_t chip; // part number to test as, or 0 to detect
+  uint16_t passes; // passes per session, or 0 to run until reset
+  uint16_t pause_ms; // retention hold with refresh off after each pass, or 0
+  Format format;
+};
+
+Settings settings = { Algorithm(TIERED_MODE), 0, 0, 0, FULL };
 
 #ifdef __AVR_ATmega328P__
 
 // PORTB [ x x DIN LED_G LED_R SEL - DOUT ]
 // NOTE Din is also built-in LED; each march pass blinks LED
+// NOTE LED_G and LED_R are also PASS and FAIL outputs in FIXTURE_MODE
 constexpr uint8_t DIN = bit_mask(5); // output
 constexpr uint8_t LED_G = bit_mask(4); // output
 constexpr uint8_t LED_R = bit_mask(3); // output
 constexpr uint8_t MODE_SEL = bit_mask(2); // input, pullups
+constexpr uint8_t BUSY = bit_mask(2); // output in FIXTURE_MODE, in place of MODE_SEL
 constexpr uint8_t A8 = bit_mask(1); // output
 constexpr uint8_t DOUT = bit_mask(0); // input
 
-// PORTC [ x x CAS RAS WE RE ERR - ]
+// PORTC [ x x CAS RAS WE RE ERR START ]
+constexpr uint8_t START = bit_mask(0); // input, pullups, active-low (FIXTURE_MODE)
 constexpr uint8_t ERR = bit_mask(1); // output
 constexpr uint8_t RE = bit_mask(2); // output, active-low (test only, not used by DRAM)
 constexpr uint8_t WE = bit_mask(3); // output, active-low
@@ -24,64 +137,447 @@ constexpr uint8_t RAS = bit_mask(4); // output, active-low
 constexpr uint8_t CAS = bit_mask(5); // output, active-low
 
 // Active-low control signals on PORTC
-constexpr uint8_t CTRL_DEFAULT = ERR | RE | WE | RAS | CAS; // all high
+// NOTE includes START to keep its pull-up on
+constexpr uint8_t CTRL_DEFAULT = START | ERR | RE | WE | RAS | CAS; // all high
 constexpr uint8_t CTRL_REFRESH = CTRL_DEFAULT & ~RAS; // pull RAS low
 constexpr uint8_t CTRL_READ_ROW = CTRL_DEFAULT & ~RAS & ~RE; // pull RAS and RE low
 constexpr uint8_t CTRL_READ_COL = CTRL_READ_ROW & ~CAS; // pull RAS, RE, and CAS low
 constexpr uint8_t CTRL_WRITE_ROW = CTRL_DEFAULT & ~RAS & ~WE; // pull RAS and WE low
 constexpr uint8_t CTRL_WRITE_COL = CTRL_WRITE_ROW & ~CAS; // pull RAS, CAS, and WE low
 constexpr uint8_t CTRL_ERROR = CTRL_DEFAULT & ~ERR; // pull ERR low
+constexpr uint8_t CTRL_PAGE = CTRL_REFRESH; // hold RAS low between CAS strobes
+constexpr uint8_t CTRL_RMW = CTRL_READ_COL & ~WE; // pull WE low after reading
+constexpr uint8_t CTRL_CBR_CAS = CTRL_DEFAULT & ~CAS; // pull CAS low
+constexpr uint8_t CTRL_CBR = CTRL_CBR_CAS & ~RAS; // pull CAS then RAS low
 
 enum Direction { UP, DN };
 enum Read { R0 = 0, R1 = DOUT, RX };
 enum Write { W0, W1, WX };
 enum Bit { Bit0, Bit1, BitX };
 enum Chip { DRAM_4164, DRAM_41256 };
+enum Refresh { NO_REFRESH, RAS_ONLY, CAS_BEFORE_RAS };
+
+// Result of the electrical check before testing
+// EMPTY: nothing drives Dout
+// MISINSERTED: Dout pulled low while no chip should drive it (backwards or offset)
+// DEAD: chip drives Dout but fails every write/read or A8 detection
+enum Socket { SOCKET_OK, EMPTY, MISINSERTED, DEAD };
+
+// How columns are accessed within one RAS cycle
+// NORMAL: full RAS cycle for every access
+// PAGE: CAS strobes each new column (all 4164 and 41256)
+// STATIC_COLUMN: column address changes while CAS stays low
+// NIBBLE: CAS toggles step through the 4 cells selected by row and col A8 (41257)
+enum Access { NORMAL, PAGE, STATIC_COLUMN, NIBBLE };
+
+// Address sequence of a march element, each generated in registers
+// LINEAR: counter with row in the low byte, so rows refresh as they go
+// GRAY: Gray code of the counter, so each step changes one address bit
+// COMPLEMENT: 0, ~0, 1, ~1, ..., so each step changes every address bit
+// COLUMN_FAST: counter with col in the low byte (polls refresh scheduler)
+// RANDOM: 0 then all 65535 states of a 16-bit LFSR (polls refresh scheduler)
+enum Order { LINEAR, GRAY, COMPLEMENT, COLUMN_FAST, RANDOM };
+
+constexpr uint32_t part_number(Chip chip) {
+  return chip == DRAM_41256 ? 41256 : 4164;
+}
 
 // Configure output pins
 void config() {
-  PORTB = MODE_SEL; // input w/ pull-up
-  DDRB = DIN | LED_G | LED_R | A8; // outputs
+  PORTB = FIXTURE_MODE ? 0 : MODE_SEL; // input w/ pull-up
+  DDRB = DIN | LED_G | LED_R | A8 | (FIXTURE_MODE ? BUSY : 0); // outputs
   PORTC = CTRL_DEFAULT; // pull-ups first
-  DDRC = CTRL_DEFAULT; // outputs, active-low
+  DDRC = CTRL_DEFAULT & ~START; // outputs, active-low
   DDRD = 0xFF; // A0-A7 outputs
 }
 
 bool is_measure_mode() {
-  return (PINB & MODE_SEL) == 0;
+  return !FIXTURE_MODE && (PINB & MODE_SEL) == 0;
+}
+
+bool is_started() {
+  return (PINC & START) == 0;
+}
+
+bool is_failed() {
+  return (PORTB & LED_R) != 0;
 }
 
 void pass() {
   // Set green LED only if red LED is clear
-  if ((PORTB & LED_R) == 0) PORTB |= LED_G;
+  if (!is_failed()) PORTB |= LED_G;
 }
 
+// Set by `fail` so multi-algorithm passes can stop early
+bool pass_failed = false;
+
+// March element of the current pass, counted from 1 by each step
+uint8_t pass_element = 0;
+
+// Set to make `fail` abandon the current pass by jumping to `abort_point`
+bool abort_on_fail = false;
+jmp_buf abort_point;
+
 void fail() {
   // Pulse error pin
   PORTC = CTRL_ERROR;
   // Set red LED, clear green LED
   PORTB |= LED_R;
   PORTB &= ~LED_G;
+  pass_failed = true;
+  // Jumping out of the failure branch keeps the passing path as fast as before
+  if (abort_on_fail) longjmp(abort_point, 1);
+}
+
+// Full address of a cell, with A8 in bit 8 of row and col
+struct Cell {
+  uint16_t row;
+  uint16_t col;
+};
+
+// Soak test statistics, kept across passes
+struct Stats {
+  uint32_t passes; // completed
+  uint32_t failed_passes;
+  uint32_t failed_reads; // saturating
+  uint32_t first_fail_pass; // 1-based
+  uint32_t last_fail_pass;
+  Cell first_fail;
+  Cell last_fail;
+};
+
+Stats stats;
+
+// Failure bitmap for one pass, compressed to fit in SRAM
+// Counts failed reads per row and col (4 bits each, saturating at 15) and
+// collects failing cells as runs down one column (consecutive rows), until
+// the run list fills up and only the row and col counts are left for a
+// mostly dead chip
+constexpr uint16_t MAP_LINES = 512; // rows or cols of 41256
+constexpr uint8_t MAP_RUNS = 64;
+constexpr uint8_t MAP_MAX_RUN = 0xFF;
+
+struct FailRun {
+  Cell start;
+  uint8_t length; // rows
+};
+
+struct FailMap {
+  uint8_t row_counts[MAP_LINES / 2];
+  uint8_t col_counts[MAP_LINES / 2];
+  FailRun runs[MAP_RUNS];
+  uint8_t run_count;
+  bool overflow;
+};
+
+// Slowest access of each row and col for the access time map in measure mode,
+// in Timer1 counts (4 bits each, 15 if slower or no Dout edge was seen)
+struct AccessMap {
+  uint8_t row_max[MAP_LINES / 2];
+  uint8_t col_max[MAP_LINES / 2];
+};
+
+// Measure mode never returns to the march, so the access time map shares
+// SRAM with the failure bitmap
+static union {
+  FailMap fail_map;
+  AccessMap access_map;
+};
+
+// Increment 4-bit saturating count at `index`
+void count_fail(uint8_t* counts, uint16_t index) {
+  uint8_t& pair = counts[index / 2];
+  const uint8_t one = index % 2 == 0 ? 0x01 : 0x10;
+  const uint8_t max = one * 0x0F;
+  if ((pair & max) != max) pair += one;
+}
+
+// Add cell to run list, extending a run when it is next to one
+void add_fail_run(Cell cell) {
+  if (fail_map.overflow) return;
+  // Search newest first, since march failures are usually in order
+  for (uint8_t i = fail_map.run_count; i-- != 0;) {
+    FailRun& run = fail_map.runs[i];
+    if (run.start.col != cell.col) continue;
+    const uint16_t offset = cell.row - run.start.row;
+    if (offset < run.length) return; // already recorded by an earlier read
+    if (run.length == MAP_MAX_RUN) continue;
+    if (offset == run.length) {
+      // Next row marching up
+      ++run.length;
+      return;
+    } else if (offset == 0xFFFF) {
+      // Next row marching down
+      --run.start.row;
+      ++run.length;
+      return;
+    }
+  }
+  if (fail_map.run_count == MAP_RUNS) {
+    fail_map.overflow = true;
+  } else {
+    fail_map.runs[fail_map.run_count++] = FailRun { cell, 1 };
+  }
+}
+
+// DRAM timing requirements in ns
+struct Timing {
+  uint16_t ras; // tRAS, RAS pulse width
+  uint16_t rah; // tRAH, row address hold after RAS
+  uint16_t rcd; // tRCD, RAS to CAS delay
+  uint16_t cac; // tCAC, access time from CAS
+  uint16_t cas; // tCAS, CAS pulse width (also tWP)
+  uint16_t rp; // tRP, RAS precharge
+};
+
+constexpr Timing TIMING_NS = { 150, 20, 25, 120, 120, 100 };
+
+// Convert ns to CPU cycles, rounding up
+constexpr uint8_t ns_to_cycles(uint16_t ns) {
+  return (uint32_t(ns) * (F_CPU / 1000000) + 999) / 1000;
 }
 
+// Convert CPU cycles to ns, rounding down
+constexpr uint16_t cycles_to_ns(uint8_t cycles) {
+  return uint32_t(cycles) * 1000 / (F_CPU / 1000000);
+}
+
+// Cycles of the instructions that time the strobes
+// An OUT changes its pins at the end of its cycle, so the time between two
+// edges counts every cycle after the OUT of the first, up to and including
+// the OUT of the second
+constexpr uint8_t OUT_CYCLES = 1; // OUT to PORTB, PORTC or PORTD, or IN from PINB
+constexpr uint8_t A8_CYCLES = 2; // SBI or CBI of A8 by `set_a8`
+// IN sees Dout through the pin synchronizer, up to 1.5 cycles late
+constexpr uint8_t IN_LATENCY_CYCLES = 2;
+
+// Delays, leaving out the OUT (or IN) that ends them
+constexpr uint8_t RAS_DELAY = ns_to_cycles(TIMING_NS.ras) - OUT_CYCLES;
+constexpr uint8_t CAS_DELAY = ns_to_cycles(TIMING_NS.cas) - OUT_CYCLES;
+constexpr uint8_t READ_DELAY = ns_to_cycles(TIMING_NS.cac) + IN_LATENCY_CYCLES - OUT_CYCLES;
+
+// Cycles between the edges of each sequence, from the OUTs and delays it runs
+// Compiler code between the strobes only makes these longer, so they are the
+// shortest each sequence can take, and are checked against TIMING_NS below
+// `read`, `write`: RAS falls, OUT col address (and SBI/CBI col A8, unless A8
+// was set outside the loop), CAS falls; the same or more in `page_step`,
+// `precharge_pair` and `capture_cell`
+constexpr uint8_t RAH_CYCLES = OUT_CYCLES;
+constexpr uint8_t RCD_CYCLES = 2 * OUT_CYCLES;
+// `speed_read`, `speed_write`: RAS falls, OUT col address, OUT col A8, CAS falls
+constexpr uint8_t SPEED_RCD_CYCLES = 3 * OUT_CYCLES;
+// `write_diagonal`, `capture_read`: the row address is also the col address,
+// so CAS falls at the next OUT
+constexpr uint8_t DIAGONAL_RCD_CYCLES = OUT_CYCLES;
+// CAS falls, READ_DELAY, IN Dout (also from the col address in static column)
+constexpr uint8_t CAC_CYCLES = READ_DELAY + OUT_CYCLES - IN_LATENCY_CYCLES;
+// `read`: CAS falls, READ_DELAY, IN Dout, CAS and RAS rise
+constexpr uint8_t READ_CAS_CYCLES = READ_DELAY + 2 * OUT_CYCLES;
+// `write` and the writes of the other sequences: CAS (or WE, for a late
+// write) falls, CAS_DELAY, CAS and RAS rise
+constexpr uint8_t WRITE_CAS_CYCLES = CAS_DELAY + OUT_CYCLES;
+// `init_dram`, `refresh_burst`: RAS falls, RAS_DELAY, RAS rises
+constexpr uint8_t REFRESH_RAS_CYCLES = RAS_DELAY + OUT_CYCLES;
+// Between RAS cycles: RAS rises, OUT next row address (or CAS for CBR), RAS
+// falls, plus loop overhead; `precharge_pair` cuts this short on purpose
+constexpr uint8_t RP_CYCLES = 2 * OUT_CYCLES;
+
+static_assert(cycles_to_ns(RAH_CYCLES) >= TIMING_NS.rah, "Row address changes before tRAH");
+static_assert(cycles_to_ns(RCD_CYCLES) >= TIMING_NS.rcd, "CAS falls before tRCD");
+static_assert(cycles_to_ns(SPEED_RCD_CYCLES) >= TIMING_NS.rcd, "CAS falls before tRCD in speed_read");
+static_assert(cycles_to_ns(DIAGONAL_RCD_CYCLES) >= TIMING_NS.rcd, "CAS falls before tRCD on the diagonal");
+static_assert(cycles_to_ns(CAC_CYCLES) >= TIMING_NS.cac, "Dout is read before tCAC");
+static_assert(cycles_to_ns(READ_CAS_CYCLES) >= TIMING_NS.cas, "CAS rises before tCAS in read");
+static_assert(cycles_to_ns(WRITE_CAS_CYCLES) >= TIMING_NS.cas, "CAS or WE rises before tCAS");
+static_assert(cycles_to_ns(RCD_CYCLES + READ_CAS_CYCLES) >= TIMING_NS.ras, "RAS rises before tRAS in read");
+static_assert(cycles_to_ns(RCD_CYCLES + WRITE_CAS_CYCLES) >= TIMING_NS.ras, "RAS rises before tRAS in write");
+static_assert(cycles_to_ns(DIAGONAL_RCD_CYCLES + WRITE_CAS_CYCLES) >= TIMING_NS.ras,
+  "RAS rises before tRAS in write_diagonal");
+static_assert(cycles_to_ns(REFRESH_RAS_CYCLES) >= TIMING_NS.ras, "RAS rises before tRAS in refresh");
+static_assert(cycles_to_ns(RP_CYCLES) >= TIMING_NS.rp, "RAS falls before tRP");
+
 // Required startup procedure per DRAM datasheets
 void init_dram() {
   // Delay 500us for bias generator
   // Others only ask for 100us, but Intel specifies 500us!
-  // 250 * 32 * 62.5ns = 500us
-  OCR2A = 250; // count to 250
-  TCCR2A = bit_mask(WGM21); // CTC mode (count to OCR2A)
-  TCCR2B = bit_mask(CS21, CS20); // set 32 prescaler (starts timer)
-  while ((TIFR2 & bit_mask(OCF2A)) == 0) {} // wait for timer
+  _delay_us(500);
 
   // 8 RAS cycle "wake-up" on any row
   for (uint8_t i = 8; i != 0; --i) {
     PORTC = CTRL_REFRESH;
-    delay_cycles<2>();
+    delay_cycles<RAS_DELAY>();
+    PORTC = CTRL_DEFAULT;
+  }
+}
+
+// Scheduled refresh for march loops that don't visit every row in time
+// Timer2 flags a burst of 8 rows every 120us, covering 256 rows in 3.84ms
+// Loops poll the flag between accesses, so a refresh never splits a cycle
+constexpr uint8_t REFRESH_BURST = 8;
+constexpr uint32_t REFRESH_PERIOD_US = 120;
+constexpr uint16_t REFRESH_TICKS = F_CPU / 32 * REFRESH_PERIOD_US / 1000000;
+static_assert(REFRESH_TICKS <= 256, "Refresh period too long for Timer2");
+
+Refresh refresh_mode = CBR_REFRESH ? CAS_BEFORE_RAS : RAS_ONLY;
+
+// Next row for RAS-only refresh (CBR uses the DRAM's internal counter)
+uint8_t refresh_row = 0;
+
+// Start Timer2 flagging refresh bursts
+void start_refresh() {
+  TCCR2B = 0;
+  TCNT2 = 0;
+  OCR2A = REFRESH_TICKS - 1;
+  TCCR2A = bit_mask(WGM21); // CTC mode (count to OCR2A)
+  TIFR2 = bit_mask(OCF2A);
+  TCCR2B = bit_mask(CS21, CS20); // set 32 prescaler (starts timer)
+}
+
+// Refresh the next burst of rows
+// Kept out of line so polling costs only a flag test between accesses
+[[gnu::noinline]]
+void refresh_burst() {
+  TIFR2 = bit_mask(OCF2A);
+  if (refresh_mode == NO_REFRESH) return;
+  for (uint8_t i = REFRESH_BURST; i != 0; --i) {
+    if (refresh_mode == CAS_BEFORE_RAS) {
+      PORTC = CTRL_CBR_CAS;
+      PORTC = CTRL_CBR;
+    } else {
+      PORTD = refresh_row++;
+      PORTC = CTRL_REFRESH;
+    }
+    // Delay for RAS pulse width
+    delay_cycles<RAS_DELAY>();
     PORTC = CTRL_DEFAULT;
   }
 }
 
+// Refresh if a burst is due
+inline void poll_refresh() {
+  if ((TIFR2 & bit_mask(OCF2A)) != 0) refresh_burst();
+}
+
+// Wait for `ms` while keeping the DRAM refreshed
+void refresh_delay_ms(uint16_t ms) {
+  for (uint32_t bursts = uint32_t(ms) * 1000 / REFRESH_PERIOD_US; bursts != 0;) {
+    if ((TIFR2 & bit_mask(OCF2A)) != 0) {
+      refresh_burst();
+      --bursts;
+    }
+  }
+}
+
+// Wait with only the given refresh
+void refresh_hold_ms(Refresh refresh, uint16_t ms) {
+  const Refresh saved = refresh_mode;
+  refresh_mode = refresh;
+  refresh_delay_ms(ms);
+  refresh_mode = saved;
+}
+
+// Stream of failing cells sent during the pass with FAIL_STREAM, as runs
+// down one column tagged with the march element, one "F element,row,col,length"
+// line per run. Runs are buffered and sent when the buffer fills (between two
+// accesses, so RAS is high) or at the end of the pass.
+// NOTE the march is paused while TXD holds A1, so every row is refreshed
+// before each line, and a line must be sent within the 2ms refresh period of
+// 4164 (4ms on 41256)
+constexpr uint8_t STREAM_RUNS = 8;
+// Longest line is "F 255,511,511,255" with both newlines, plus 2 idle frames
+constexpr uint32_t STREAM_LINE_US = 21 * 10 * 1000000 / SERIAL_BAUD;
+// Refreshing 256 rows takes about RAS_DELAY + 8 cycles per row
+constexpr uint32_t STREAM_REFRESH_US = 256 * (RAS_DELAY + 8) / (F_CPU / 1000000);
+// TXD holds A1 for the whole line, so refresh can't be split across it
+static_assert(!FAIL_STREAM || STREAM_LINE_US + STREAM_REFRESH_US < 2000,
+  "FAIL_STREAM needs F_CPU of at least 16 MHz to refresh between lines");
+
+struct StreamRun {
+  uint8_t element;
+  Cell start;
+  uint8_t length; // rows
+};
+
+struct FailStream {
+  StreamRun runs[STREAM_RUNS];
+  uint8_t run_count;
+};
+
+FailStream fail_stream;
+
+// Refresh every row now, wherever the scheduler is
+void refresh_all() {
+  for (uint8_t i = 256 / REFRESH_BURST; i != 0; --i) refresh_burst();
+}
+
+// Send buffered runs, refreshing all rows before each line
+[[gnu::noinline]]
+void flush_stream() {
+  for (uint8_t i = 0; i < fail_stream.run_count; ++i) {
+    const StreamRun& run = fail_stream.runs[i];
+    refresh_all();
+    serial_begin();
+    serial_print_P(PSTR("F "));
+    serial_print(run.element);
+    serial_write(',');
+    serial_print(run.start.row);
+    serial_write(',');
+    serial_print(run.start.col);
+    serial_write(',');
+    serial_print(run.length);
+    serial_end();
+  }
+  fail_stream.run_count = 0;
+}
+
+// Add cell to the stream, extending the last run when it is the next row in
+// the same element
+void stream_fail(Cell cell) {
+  if (fail_stream.run_count != 0) {
+    StreamRun& run = fail_stream.runs[fail_stream.run_count - 1];
+    if (run.element == pass_element && run.start.col == cell.col && run.length != MAP_MAX_RUN) {
+      const uint16_t offset = cell.row - run.start.row;
+      if (offset == run.length) {
+        // Next row marching up
+        ++run.length;
+        return;
+      } else if (offset == 0xFFFF) {
+        // Next row marching down
+        --run.start.row;
+        ++run.length;
+        return;
+      }
+    }
+    if (fail_stream.run_count == STREAM_RUNS) flush_stream();
+  }
+  fail_stream.runs[fail_stream.run_count++] = StreamRun { pass_element, cell, 1 };
+}
+
+// Record failed read at `cell`, then signal failure
+// Kept out of line so the march loop only pays for the call on failure
+[[gnu::noinline]]
+void fail(Cell cell) {
+  const uint32_t pass = stats.passes + 1;
+  if (stats.failed_reads == 0) {
+    stats.first_fail_pass = pass;
+    stats.first_fail = cell;
+  }
+  if (stats.failed_reads + 1 != 0) ++stats.failed_reads;
+  stats.last_fail_pass = pass;
+  stats.last_fail = cell;
+  count_fail(fail_map.row_counts, cell.row);
+  count_fail(fail_map.col_counts, cell.col);
+  add_fail_run(cell);
+  if (FAIL_STREAM) stream_fail(cell);
+  fail();
+}
+
+// Update statistics after a completed pass
+void count_pass() {
+  ++stats.passes;
+  if (pass_failed) ++stats.failed_passes;
+}
+
 // Set upper address bit
 template <Bit BIT>
 void set_a8() {
@@ -92,7 +588,18 @@ void set_a8() {
   }
 }
 
+// Get full address of cell, where BitX means A8 was set outside the loop
+template <Bit ROW_A8, Bit COL_A8>
+Cell cell_at(uint8_t row, uint8_t col) {
+  const uint16_t a8 = (PORTB & A8) != 0 ? 0x100 : 0;
+  return Cell {
+    uint16_t(row | (ROW_A8 == Bit1 ? 0x100 : ROW_A8 == Bit0 ? 0 : a8)),
+    uint16_t(col | (COL_A8 == Bit1 ? 0x100 : COL_A8 == Bit0 ? 0 : a8)),
+  };
+}
+
 // Perform read cycle at `address`
+// Timed by RAH_CYCLES, RCD_CYCLES, CAC_CYCLES and READ_CAS_CYCLES
 template <Bit ROW_A8 = BitX, Bit COL_A8 = BitX>
 Read read(uint8_t row, uint8_t col) {
   // Strobe row address
@@ -103,8 +610,8 @@ Read read(uint8_t row, uint8_t col) {
   PORTD = col;
   set_a8<COL_A8>();
   PORTC = CTRL_READ_COL;
-  // Delay 2 for tCAC > 120ns, +1 for AVR read latency
-  delay_cycles<3>();
+  // Delay for tCAC, plus AVR read latency
+  delay_cycles<READ_DELAY>();
   // Validate data is expected value
   Read result = Read(PINB & DOUT);
   // Reset control signals
@@ -113,6 +620,7 @@ Read read(uint8_t row, uint8_t col) {
 }
 
 // Perform write cycle at `address`
+// Timed by RAH_CYCLES, RCD_CYCLES and WRITE_CAS_CYCLES
 template <Bit ROW_A8 = BitX, Bit COL_A8 = BitX>
 void write(uint8_t row, uint8_t col) {
   // Strobe row address
@@ -123,8 +631,8 @@ void write(uint8_t row, uint8_t col) {
   PORTD = col;
   set_a8<COL_A8>();
   PORTC = CTRL_WRITE_COL;
-  // Delay for tCAS > 120 (OUT + NOP)
-  delay_cycles();
+  // Delay for tCAS
+  delay_cycles<CAS_DELAY>();
   // Reset control signals
   PORTC = CTRL_DEFAULT;
 }
@@ -140,22 +648,209 @@ void set_data() {
 }
 
 // Detect 41256 by writing and reading at different values of A8
+template <Write LOWER = W1>
 bool is_41256() {
-  // Write 1 to lower bank
-  set_data<W1>();
+  // Write 1 (or `LOWER`) to lower bank
+  set_data<LOWER>();
   write<Bit0, Bit0>(0, 0);
-  // Write 0 to upper bank
-  set_data<W0>();
+  // Write 0 (or the opposite) to upper bank
+  set_data<LOWER == W1 ? W0 : W1>();
   write<Bit1, Bit1>(0, 0);
   // If lower bank still reads 1, it's a 256
-  return read<Bit0, Bit0>(0, 0) == R1;
+  return read<Bit0, Bit0>(0, 0) == (LOWER == W1 ? R1 : R0);
 }
 
-[[noreturn]]
-void measure_rac() {
-  uint8_t address = 0;
+// Read `cell` outside of the march loop, where A8 is only known at runtime
+Read read_cell(Cell cell) {
+  const uint8_t row = cell.row;
+  const uint8_t col = cell.col;
+  switch ((cell.row >> 8) | (cell.col >> 7 & 0x02)) {
+  case 0: return read<Bit0, Bit0>(row, col);
+  case 1: return read<Bit1, Bit0>(row, col);
+  case 2: return read<Bit0, Bit1>(row, col);
+  default: return read<Bit1, Bit1>(row, col);
+  }
+}
+
+// Write Din to `cell` outside of the march loop
+void write_cell(Cell cell) {
+  const uint8_t row = cell.row;
+  const uint8_t col = cell.col;
+  switch ((cell.row >> 8) | (cell.col >> 7 & 0x02)) {
+  case 0: write<Bit0, Bit0>(row, col); break;
+  case 1: write<Bit1, Bit0>(row, col); break;
+  case 2: write<Bit0, Bit1>(row, col); break;
+  default: write<Bit1, Bit1>(row, col); break;
+  }
+}
+
+// Set upper address bit at runtime, for loops that cover all 4 A8 quadrants
+void set_a8(bool bit) {
+  if (bit) {
+    PORTB |= A8;
+  } else {
+    PORTB &= ~A8;
+  }
+}
+
+// Cells spread over rows and columns for `check_socket`
+constexpr uint8_t CHECK_CELLS = 8;
+constexpr uint8_t CHECK_ROW_STEP = 0x25;
+constexpr uint8_t CHECK_COL_STEP = 0x49;
+
+// Check that a chip is in the socket the right way round, in well under 1ms
+// NOTE Dout is high impedance unless CAS is low, so with the pull-up on it
+// only reads 0 when a working chip drives it
+Socket check_socket() {
+  PORTB |= DOUT; // pull-up
+  Socket result = SOCKET_OK;
+  // Something else pulls Dout low while idle, like the input clamp diodes of
+  // a chip put in backwards when its supply pin (A7) is low
+  for (uint8_t i = 0; i < 4 && result == SOCKET_OK; ++i) {
+    PORTD = i & 1 ? 0xFF : 0x00;
+    set_a8(i & 2);
+    _delay_us(10);
+    if ((PINB & DOUT) == 0) result = MISINSERTED;
+  }
+  if (result == SOCKET_OK) {
+    // Write then read back both values at a few cells
+    bool driven = false;
+    uint8_t good = 0;
+    for (uint8_t i = 0; i < CHECK_CELLS; ++i) {
+      const uint8_t row = i * CHECK_ROW_STEP;
+      const uint8_t col = i * CHECK_COL_STEP;
+      set_data<W0>();
+      write<Bit0, Bit0>(row, col);
+      const Read zero = read<Bit0, Bit0>(row, col);
+      set_data<W1>();
+      write<Bit0, Bit0>(row, col);
+      const Read one = read<Bit0, Bit0>(row, col);
+      if (zero == R0) driven = true;
+      if (zero == R0 && one == R1) ++good;
+    }
+    if (!driven) {
+      // Nothing ever pulled Dout low
+      result = EMPTY;
+    } else if (good == 0 || is_41256<W1>() != is_41256<W0>()) {
+      // Chip drives Dout but can't store data, or gives nonsense for A8
+      result = DEAD;
+    }
+  }
+  PORTB &= ~DOUT;
+  return result;
+}
+
+// Read then write (both optional) the next column while RAS is held low
+// Row is already strobed; for static column, CAS is already low too
+// Timed by CAC_CYCLES and WRITE_CAS_CYCLES (open_page adds A8 to RCD_CYCLES)
+// Returns true if the read failed; NOTE don't call `fail` until RAS is high
+template <Access ACCESS, Read READ, Write WRITE>
+bool page_step(uint8_t col) {
+  if (ACCESS != NIBBLE) PORTD = col;
+  if (ACCESS != STATIC_COLUMN) {
+    // Early write when not reading
+    PORTC = READ != RX ? CTRL_READ_COL : CTRL_WRITE_COL;
+  }
+  bool failed = false;
+  if (READ != RX) {
+    // Delay for tCAC (or tAA), plus AVR read latency
+    delay_cycles<READ_DELAY>();
+    failed = Read(PINB & DOUT) != READ;
+  }
+  if (WRITE != WX && (READ != RX || ACCESS == STATIC_COLUMN)) {
+    // Late write, keeping CAS low
+    PORTC = CTRL_RMW;
+  }
+  // Delay for tCAS or tWP
+  delay_cycles<CAS_DELAY>();
+  // Raise CAS (or just WE for static column) for the next column
+  PORTC = ACCESS == STATIC_COLUMN ? CTRL_READ_COL : CTRL_PAGE;
+  return failed;
+}
+
+// Hold RAS low at `row` and open the column for `page_step`
+template <Access ACCESS>
+void open_page(uint8_t row, uint8_t col, uint8_t a8) {
+  PORTD = row;
+  set_a8(a8 & 0x01);
+  PORTC = CTRL_PAGE;
+  set_a8(a8 & 0x02);
+  if (ACCESS == NIBBLE) {
+    // First CAS strobe latches the column; then the nibble counter takes over
+    PORTD = col;
+  } else if (ACCESS == STATIC_COLUMN) {
+    PORTD = col;
+    PORTC = CTRL_READ_COL;
+  }
+}
+
+// Check two columns of one row can be read within one RAS cycle
+template <Access ACCESS>
+bool reads_in_page() {
+  // Try both polarities so a stuck Dout can't pass
+  for (uint8_t first = 0; first < 2; ++first) {
+    if (first) set_data<W1>(); else set_data<W0>();
+    write<Bit0, Bit0>(0, 0);
+    if (first) set_data<W0>(); else set_data<W1>();
+    write<Bit0, Bit0>(0, 1);
+    open_page<ACCESS>(0, 0, 0);
+    const bool failed = first
+      ? page_step<ACCESS, R1, WX>(0) || page_step<ACCESS, R0, WX>(1)
+      : page_step<ACCESS, R0, WX>(0) || page_step<ACCESS, R1, WX>(1);
+    PORTC = CTRL_DEFAULT;
+    if (failed) return false;
+  }
+  return true;
+}
+
+// Check CAS strobes new columns within one RAS cycle
+bool has_page_mode() {
+  return reads_in_page<PAGE>();
+}
+
+// Check column address changes are seen with CAS held low
+// Other chips latch the column on the falling edge of CAS
+bool has_static_column() {
+  return reads_in_page<STATIC_COLUMN>();
+}
+
+// A8 quadrant (row A8 | col A8 << 1) reached at each step of a nibble cycle
+uint8_t nibble_order[4];
+
+// Check CAS toggles step through the 4 A8 quadrants (41256 only), saving the
+// order in `nibble_order`; page mode chips just read the same cell again
+bool has_nibble_mode() {
+  uint8_t seen = 0;
+  for (uint8_t target = 0; target < 4; ++target) {
+    // Mark one quadrant of the nibble at row 0, col 0
+    for (uint8_t a8 = 0; a8 < 4; ++a8) {
+      if (a8 == target) set_data<W1>(); else set_data<W0>();
+      write_cell(Cell { uint16_t(a8 << 8 & 0x100), uint16_t(a8 << 7 & 0x100) });
+    }
+    // Find which nibble step reads the marked quadrant
+    open_page<NIBBLE>(0, 0, 0);
+    uint8_t steps = 0;
+    for (uint8_t step = 0; step < 4; ++step) {
+      if (page_step<NIBBLE, R0, WX>(0)) steps |= bit_mask(step);
+    }
+    PORTC = CTRL_DEFAULT;
+    // Exactly one new step must read the mark
+    if (steps == 0 || (steps & (steps - 1)) != 0 || (steps & seen) != 0) return false;
+    seen |= steps;
+    for (uint8_t step = 0; step < 4; ++step) {
+      if (steps == bit_mask(step)) nibble_order[step] = target;
+    }
+  }
+  // Nibble cycle must start at the strobed address
+  return nibble_order[0] == 0;
+}
 
-  // Write alternating bits along diagonal
+// Write alternating bits along diagonal
+// Timed by DIAGONAL_RCD_CYCLES and WRITE_CAS_CYCLES
+void write_diagonal() {
+  // First toggle writes 1 at address 0
+  set_data<W0>();
+  uint8_t address = 0;
   do {
     // Toggle data
     PINB |= DIN;
@@ -163,153 +858,2050 @@ void measure_rac() {
     PORTD = address;
     PORTC = CTRL_WRITE_ROW;
     PORTC = CTRL_WRITE_COL;
-    // Delay for CAS strobe width
-    ++address;
+    // Delay for tCAS
+    delay_cycles<CAS_DELAY>();
     PORTC = CTRL_DEFAULT;
-  } while (address != 0);
+  } while (++address != 0);
+}
 
-  // Read forever along diagonal
-  uint8_t blinks = 2;
-  uint16_t phase = 0;
-  for (;;) {
-    // Toggle input capture edge and reset flag
-    TCCR1B ^= bit_mask(ICES1);
+// Start Timer1 capturing the next Dout edge, opposite to the last one
+inline void start_capture() {
+  // Toggle input capture edge and reset flag
+  TCCR1B ^= bit_mask(ICES1);
+  TIFR1 |= bit_mask(ICF1);
+  // Start input capture timer
+  TCCR1B |= bit_mask(CS10);
+}
+
+// Stop Timer1, returning counts from `start_capture` to Dout edge, or 0 if none
+inline uint8_t stop_capture() {
+  // Test input capture flag
+  uint8_t count = 0;
+  if ((TIFR1 & bit_mask(ICF1)) != 0) {
+    count = ICR1L;
     TIFR1 |= bit_mask(ICF1);
-    // Start input capture timer
-    TCCR1B |= bit_mask(CS10);
-    // Use same byte for row and col (diagonal)
+  }
+  // Stop input capture timer
+  TCCR1B &= ~bit_mask(CS10);
+  TCNT1 = 0;
+  return count;
+}
+
+// RAS to CAS delay for measuring tCAC, well past tRCD max (tRAC - tCAC, at
+// most 100ns on 4164 and 41256), so Dout follows CAS alone
+constexpr uint8_t CAC_RCD_DELAY = ns_to_cycles(200);
+
+// Read diagonal at `address` with Timer1 capturing the Dout edge
+// Call in address order after `write_diagonal` so Dout toggles every read
+// Counts from just before RAS (tRAC), or from CAS with `FROM_CAS` (tCAC)
+// Timed by DIAGONAL_RCD_CYCLES (or CAC_RCD_DELAY) and CAC_CYCLES
+// Returns counts to Dout edge, or 0 if none
+template <bool FROM_CAS = false>
+uint8_t capture_read(uint8_t address) {
+  // Use same byte for row and col (diagonal)
+  uint8_t count;
+  if (FROM_CAS) {
+    PORTD = address;
+    PORTC = CTRL_READ_ROW;
+    delay_cycles<CAC_RCD_DELAY>();
+    start_capture();
+    PORTC = CTRL_READ_COL;
+    // Delay for read access time
+    delay_cycles<READ_DELAY>();
+    count = stop_capture();
+  } else {
+    start_capture();
     // This is the fastest we can toggle CAS after RAS, stressing row access time
     PORTD = address;
     PORTC = CTRL_READ_ROW;
     PORTC = CTRL_READ_COL;
     // Delay for read access time
     // Probe RAS and DOUT with scope
-    delay_cycles<2>();
-    ++address;
-    // Test input capture flag
-    if ((TIFR1 & bit_mask(ICF1)) != 0) {
-      // All chips tested at 5 counts, so use this as median
-      // Faster chips get 1 blink, slower chips get 3 blinks
-      // TODO clean this up, account for CPU clock rate
-      uint8_t count = ICR1L;
-      if (count > 5) {
-        blinks = 3;
-      } else if (count < 5) {
-        blinks = 1;
-      }
-      TIFR1 |= bit_mask(ICF1);
-    } else {
-      fail();
-    }
-    PORTC = CTRL_DEFAULT;
-    // Stop input capture timer
-    TCCR1B &= ~bit_mask(CS10);
-    TCNT1 = 0;
-
-    // Blink green LED between passes
-    if (address == 0) {
-      if ((phase & 0xFF) == 0) {
-        if ((phase >> 8 & 0x03) == 0 && (phase >> 10 & 0x03) < blinks) {
-          PORTB |= LED_G;
-        } else if ((phase >> 8 & 0x03) == 0x02) {
-          PORTB &= ~LED_G;
-        }
-      }
-      ++phase;
-    }
+    delay_cycles<READ_DELAY>();
+    count = stop_capture();
   }
+  PORTC = CTRL_DEFAULT;
+  return count;
 }
 
-#else
-#error Must define I/O for current chip; see ifdef __AVR_ATmega328P__ above
-#endif
+// Columns read per RAS cycle by the page measurements, like `march_page_once`,
+// so RAS stays low for less than tRAS max
+constexpr uint8_t MEASURE_PAGE = 4;
 
-// Loop over the 8-bit x 8-bit address range, up or down
-// Read then write (both optional) once at each address along the way
-// NOTE use the lower byte as the row so a refresh is done at each step
-template <Direction DIR, Read READ, Write WRITE, Bit ROW_A8 = BitX, Bit COL_A8 = BitX>
-void march_once() {
-  if (ROW_A8 == COL_A8 && ROW_A8 != BitX) {
-    // Optimization for non-changing A8 value
-    set_a8<ROW_A8>();
-    march_once<DIR, READ, WRITE>();
-  } else {
-    uint16_t address = 0;
-    do {
-      if (DIR == DN) --address;
-      const uint8_t col = address >> 8;
-      const uint8_t row = address & 0xFF;
-      if (READ != RX && read<ROW_A8, COL_A8>(row, col) != READ) fail();
-      if (WRITE != WX) write<ROW_A8, COL_A8>(row, col);
-      if (DIR == UP) ++address;
-    } while (address != 0);
-  }
+// Write alternating bits along row 0, starting with 1 like `write_diagonal`
+void write_row() {
+  set_data<W0>();
+  uint8_t col = 0;
+  do {
+    PINB |= DIN;
+    write(0, col);
+  } while (++col != 0);
 }
 
-// Perform one step of march algorithm
-template <Chip CHIP, Direction DIR, Read READ, Write WRITE>
-void march_step() {
-  // Data is same for all writes, so set Din once outside loop
-  set_data<WRITE>();
+// Read row 0 a page at a time after `write_row`, with Timer1 capturing each
+// Dout edge from the CAS rise before it (tCPA); CAS is high for 2 cycles, so
+// Dout would follow CAS fall (tCAC) much later if the chip waited for it
+// The first column of each page is read without timing
+// Returns the slowest count, or 0 if an edge was missed
+uint8_t capture_cpa() {
+  uint8_t slowest = 0;
+  bool missed = false;
+  uint8_t col = 0;
+  do {
+    PORTD = 0;
+    PORTC = CTRL_READ_ROW;
+    PORTD = col;
+    start_capture();
+    PORTC = CTRL_READ_COL;
+    delay_cycles<READ_DELAY>();
+    (void)stop_capture();
+    for (uint8_t i = 1; i < MEASURE_PAGE; ++i) {
+      start_capture();
+      PORTC = CTRL_READ_ROW;
+      PORTD = ++col;
+      PORTC = CTRL_READ_COL;
+      delay_cycles<READ_DELAY>();
+      const uint8_t count = stop_capture();
+      if (count == 0) missed = true;
+      if (count > slowest) slowest = count;
+    }
+    PORTC = CTRL_DEFAULT;
+  } while (++col != 0);
+  return missed ? 0 : slowest;
+}
 
-  if (CHIP == DRAM_41256) {
-    if (DIR == UP) {
-      // Increment A8 bits
-      march_once<UP, READ, WRITE, Bit0, Bit0>();
-      march_once<UP, READ, WRITE, Bit1, Bit0>();
-      march_once<UP, READ, WRITE, Bit0, Bit1>();
-      march_once<UP, READ, WRITE, Bit1, Bit1>();
-    } else {
-      // Decrement A8 bits
-      march_once<DN, READ, WRITE, Bit1, Bit1>();
-      march_once<DN, READ, WRITE, Bit0, Bit1>();
-      march_once<DN, READ, WRITE, Bit1, Bit0>();
-      march_once<DN, READ, WRITE, Bit0, Bit0>();
+// Read row 0 a page at a time after `write_row`, reading Dout `DELAY` cycles
+// after each CAS fall, with Timer1 timing each page
+// Returns the slowest page cycle in counts, or 0 if any read was wrong
+template <uint8_t DELAY>
+uint8_t time_page_cycle() {
+  uint16_t slowest = 0;
+  uint8_t col = 0;
+  do {
+    PORTD = 0;
+    PORTC = CTRL_READ_ROW;
+    uint8_t failed = 0;
+    TCCR1B = bit_mask(CS10);
+    for (uint8_t i = 0; i < MEASURE_PAGE; ++i, ++col) {
+      PORTD = col;
+      PORTC = CTRL_READ_COL;
+      delay_cycles<DELAY>();
+      // Even columns hold 1
+      failed |= (PINB ^ ((col & 1) != 0 ? 0 : DOUT)) & DOUT;
+      PORTC = CTRL_READ_ROW;
     }
-  } else {
-    march_once<DIR, READ, WRITE>();
-  }
+    TCCR1B = 0;
+    const uint16_t counts = TCNT1;
+    TCNT1 = 0;
+    PORTC = CTRL_DEFAULT;
+    if (failed != 0) return 0;
+    if (counts > slowest) slowest = counts;
+  } while (col != 0);
+  return (slowest + MEASURE_PAGE / 2) / MEASURE_PAGE;
 }
 
-// Default unpecified write to WX
-template <Chip CHIP, Direction DIR, Read READ>
-void march_step() {
-  march_step<CHIP, DIR, READ, WX>();
+// Result of `step_down`: what the last passing sweep returned, or 0 if even
+// the first one failed, and whether the lowest delay passed, so the chip is
+// faster than the tester can show
+struct StepDown {
+  uint8_t result;
+  bool limit;
+};
+
+// Set by the kernels of a `step_down` sweep instead of `fail`, since failures
+// are expected once the delay is short enough
+bool sweep_failed = false;
+
+// Run `SWEEP::run<DELAY>()`, then again one cycle shorter each time down to
+// `MIN`, until it returns 0 for a failure
+// Every delay is a separate instantiation, so the sweep keeps exact timing
+template <typename SWEEP, uint8_t DELAY, uint8_t MIN>
+StepDown step_down() {
+  const uint8_t result = SWEEP::template run<DELAY>();
+  if (result == 0) return StepDown { 0, false };
+  if (DELAY <= MIN) return StepDown { result, true };
+  const StepDown shorter = step_down<SWEEP, (DELAY <= MIN ? MIN : DELAY - 1), MIN>();
+  return shorter.result != 0 ? shorter : StepDown { result, false };
 }
 
-// Default unpecified read to RX
-template <Chip CHIP, Direction DIR, Write WRITE>
-void march_step() {
-  march_step<CHIP, DIR, RX, WRITE>();
+// Page cycle sweep for `step_down`, returning counts per page cycle
+struct PageCycleSweep {
+  template <uint8_t DELAY>
+  static uint8_t run() { return time_page_cycle<DELAY>(); }
+};
+
+// Stop Timer1 and select falling edge, ready for `capture_read`
+void reset_capture() {
+  TIMSK1 = 0;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
 }
 
-// Run march C- algorithm in a loop
-// LED turns green after first success, but stays red after first failure
-template <Chip CHIP>
-void march() {
-  for (;;) {
-    march_step<CHIP, UP, W0>();
-    march_step<CHIP, UP, R0, W1>();
-    march_step<CHIP, UP, R1, W0>();
-    march_step<CHIP, DN, R0, W1>();
-    march_step<CHIP, DN, R1, W0>();
-    march_step<CHIP, DN, R0>();
-    pass();
-  }
+// Convert Timer1 counts to nanoseconds
+constexpr uint16_t counts_to_ns(uint8_t counts) {
+  return uint32_t(counts) * 1000 / (F_CPU / 1000000);
 }
 
-int main() {
+// Sweep the diagonal once and return the slowest access time in ns
+// NOTE uses Timer1, so do this before starting the stopwatch
+uint16_t sample_rac() {
+  reset_capture();
+  write_diagonal();
+  uint8_t slowest = 0;
+  uint8_t address = 0;
+  do {
+    const uint8_t count = capture_read(address);
+    if (count > slowest) slowest = count;
+  } while (++address != 0);
+  return counts_to_ns(slowest);
+}
+
+// All chips tested at 5 counts at 16 MHz, so use this as median
+constexpr uint16_t RAC_MEDIAN_NS = 312;
+
+// Histogram of diagonal access times in Timer1 counts, over RAC_SWEEPS sweeps
+// Bin 0 counts reads with no Dout edge, and the last bin also counts slower reads
+constexpr uint8_t RAC_BINS = 16;
+constexpr uint8_t RAC_SWEEPS = 255; // bins of 16 bits can't overflow
+constexpr uint8_t RAC_SLOWEST = 4;
+// Reads this many counts slower than the median flag a few slow cells
+constexpr uint8_t RAC_OUTLIER_COUNTS = 2;
+
+struct RacHistogram {
+  uint16_t bins[RAC_BINS];
+  // Slowest addresses seen, slowest first, with their worst counts
+  uint8_t slowest[RAC_SLOWEST];
+  uint8_t slowest_counts[RAC_SLOWEST];
+};
+
+RacHistogram rac_histogram;
+
+// Add read of `address` taking `count` to the histogram
+void count_rac(uint8_t address, uint8_t count) {
+  RacHistogram& hist = rac_histogram;
+  ++hist.bins[count < RAC_BINS ? count : RAC_BINS - 1];
+  // Keep each address once in the slowest list, at its worst count
+  uint8_t i = 0;
+  while (i < RAC_SLOWEST - 1 && hist.slowest[i] != address) ++i;
+  // Otherwise `i` is the last slot, which a faster read can't take
+  if (hist.slowest_counts[i] >= count) return;
+  for (; i != 0 && hist.slowest_counts[i - 1] < count; --i) {
+    hist.slowest[i] = hist.slowest[i - 1];
+    hist.slowest_counts[i] = hist.slowest_counts[i - 1];
+  }
+  hist.slowest[i] = address;
+  hist.slowest_counts[i] = count;
+}
+
+// Bin holding the median read, ignoring reads with no Dout edge
+uint8_t rac_median() {
+  const uint16_t* bins = rac_histogram.bins;
+  uint16_t total = 0;
+  for (uint8_t count = 1; count < RAC_BINS; ++count) total += bins[count];
+  uint16_t seen = 0;
+  for (uint8_t count = 1; count < RAC_BINS; ++count) {
+    seen += bins[count];
+    if (seen != 0 && seen >= total - seen) return count;
+  }
+  return 0;
+}
+
+// Send access time histogram under `tag` ("RAC" or "CAC"), returning number
+// of outlier reads
+uint16_t report_rac(const char* tag, uint8_t median) {
+  const RacHistogram& hist = rac_histogram;
+  uint8_t min = 0;
+  uint8_t max = 0;
+  uint16_t outliers = 0;
+  for (uint8_t count = 1; count < RAC_BINS; ++count) {
+    if (hist.bins[count] == 0) continue;
+    if (min == 0) min = count;
+    max = count;
+    if (count >= median + RAC_OUTLIER_COUNTS) outliers += hist.bins[count];
+  }
+  serial_begin();
+  serial_print_P(tag);
+  serial_field_P(PSTR("min_ns"), counts_to_ns(min));
+  serial_field_P(PSTR("median_ns"), counts_to_ns(median));
+  serial_field_P(PSTR("max_ns"), counts_to_ns(max));
+  serial_field_P(PSTR("missing"), hist.bins[0]);
+  serial_field_P(PSTR("outliers"), outliers);
+  serial_end();
+  // "counts:reads" for each bin with reads, counts as Timer1 counts
+  serial_begin();
+  serial_print_P(tag);
+  serial_print_P(PSTR("_HIST"));
+  for (uint8_t count = 0; count < RAC_BINS; ++count) {
+    if (hist.bins[count] == 0) continue;
+    serial_write(' ');
+    serial_print(count);
+    serial_write(':');
+    serial_print(hist.bins[count]);
+  }
+  serial_end();
+  // "address:ns" of the slowest diagonal addresses
+  serial_begin();
+  serial_print_P(tag);
+  serial_print_P(PSTR("_SLOW"));
+  for (uint8_t i = 0; i < RAC_SLOWEST && hist.slowest_counts[i] != 0; ++i) {
+    serial_write(' ');
+    serial_print(hist.slowest[i]);
+    serial_write(':');
+    serial_print(counts_to_ns(hist.slowest_counts[i]));
+  }
+  serial_end();
+  return outliers;
+}
+
+// Read `row`, `col` with Timer1 capturing the Dout edge, with the same
+// timing as `read` (so as the march sees it, if A8 is passed the same way)
+// Returns counts from timer start (just before RAS) to Dout edge, or 0 if none
+template <Bit ROW_A8, Bit COL_A8>
+uint8_t capture_cell(uint8_t row, uint8_t col) {
+  start_capture();
+  PORTD = row;
+  set_a8<ROW_A8>();
+  PORTC = CTRL_READ_ROW;
+  PORTD = col;
+  set_a8<COL_A8>();
+  PORTC = CTRL_READ_COL;
+  delay_cycles<READ_DELAY>();
+  const uint8_t count = stop_capture();
+  PORTC = CTRL_DEFAULT;
+  return count;
+}
+
+// Raise 4-bit value at `index` to `count`
+void max_nibble(uint8_t* values, uint16_t index, uint8_t count) {
+  uint8_t& pair = values[index / 2];
+  if (index % 2 == 0) {
+    if ((pair & 0x0F) < count) pair = (pair & 0xF0) | count;
+  } else {
+    if ((pair >> 4) < count) pair = (pair & 0x0F) | count << 4;
+  }
+}
+
+// Time every read over one A8 quadrant into `access_map`, where BitX means A8
+// was set outside the loop
+// Rows alternate 1 and 0, so Dout toggles at every read in row-fast order,
+// which also keeps the rows refreshed
+template <Bit ROW_A8, Bit COL_A8>
+void map_access_once() {
+  if (ROW_A8 == COL_A8 && ROW_A8 != BitX) {
+    // Set A8 outside the loop like `march_once`, so reads take the same time
+    set_a8<ROW_A8>();
+    map_access_once<BitX, BitX>();
+    return;
+  }
+  uint16_t address = 0;
+  do {
+    const uint8_t row = address & 0xFF;
+    if ((row & 1) == 0) set_data<W1>(); else set_data<W0>();
+    write<ROW_A8, COL_A8>(row, address >> 8);
+  } while (++address != 0);
+  // Leave Dout low, so the first capture (rising) sees row 0
+  (void)read<ROW_A8, COL_A8>(1, 0);
+  reset_capture();
+  const uint16_t a8 = (PORTB & A8) != 0 ? 0x100 : 0;
+  const uint16_t row_a8 = ROW_A8 == Bit1 ? 0x100 : ROW_A8 == Bit0 ? 0 : a8;
+  const uint16_t col_a8 = COL_A8 == Bit1 ? 0x100 : COL_A8 == Bit0 ? 0 : a8;
+  do {
+    const uint8_t row = address & 0xFF;
+    const uint8_t col = address >> 8;
+    uint8_t count = capture_cell<ROW_A8, COL_A8>(row, col);
+    if (count == 0 || count > 0x0F) count = 0x0F;
+    max_nibble(access_map.row_max, row | row_a8, count);
+    max_nibble(access_map.col_max, col | col_a8, count);
+  } while (++address != 0);
+}
+
+// Send " index:ns" for each 4-bit count in `values`
+void report_access_lines(const uint8_t* values, uint16_t lines) {
+  for (uint16_t i = 0; i < lines; ++i) {
+    const uint8_t pair = values[i / 2];
+    serial_write(' ');
+    serial_print(i);
+    serial_write(':');
+    serial_print(counts_to_ns(i % 2 == 0 ? pair & 0x0F : pair >> 4));
+  }
+}
+
+// Time reads of every cell, then send the slowest access of each row and col
+void map_access(bool is_256) {
+  memset(&access_map, 0, sizeof(AccessMap));
+  if (is_256) {
+    map_access_once<Bit0, Bit0>();
+    map_access_once<Bit1, Bit0>();
+    map_access_once<Bit0, Bit1>();
+    map_access_once<Bit1, Bit1>();
+  } else {
+    map_access_once<Bit0, Bit0>();
+  }
+  const uint16_t lines = is_256 ? 512 : 256;
+  uint8_t slowest = 0;
+  for (uint16_t i = 0; i < lines / 2; ++i) {
+    const uint8_t pair = access_map.row_max[i];
+    if ((pair & 0x0F) > slowest) slowest = pair & 0x0F;
+    if ((pair >> 4) > slowest) slowest = pair >> 4;
+  }
+  serial_begin();
+  serial_print_P(PSTR("AMAP"));
+  serial_field_P(PSTR("chip"), part_number(is_256 ? DRAM_41256 : DRAM_4164));
+  serial_field_P(PSTR("max_ns"), counts_to_ns(slowest));
+  serial_print_P(PSTR("\nAMAP_ROWS"));
+  report_access_lines(access_map.row_max, lines);
+  serial_print_P(PSTR("\nAMAP_COLS"));
+  report_access_lines(access_map.col_max, lines);
+  serial_end();
+}
+
+// Send page mode timing from row 0, leaving row 0 overwritten
+// `pc_ns` is the shortest page cycle that still reads row 0 correctly, with
+// `limit=1` if that was at 0 delay, where the loop itself is the limit
+void report_page() {
+  write_row();
+  reset_capture();
+  const uint8_t cpa = capture_cpa();
+  const StepDown pc = step_down<PageCycleSweep, READ_DELAY, 0>();
+  serial_begin();
+  serial_print_P(PSTR("PAGE"));
+  serial_field_P(PSTR("cpa_ns"), counts_to_ns(cpa));
+  serial_field_P(PSTR("pc_ns"), counts_to_ns(pc.result));
+  serial_field_P(PSTR("limit"), pc.limit);
+  serial_end();
+}
+
+// Read the diagonal forever, blinking the speed bucket of the median access
+// time (1 = faster, 2 = typical, 3 = slower) and sending histograms of tRAC
+// then tCAC every RAC_SWEEPS sweeps, followed by page mode timing and the
+// access time map of the whole chip
+// The red LED is set by missing reads or a few slow cells
+[[noreturn]]
+void measure_rac() {
+  const bool is_256 = is_41256();
+  uint8_t blinks = 2;
+  uint16_t phase = 0;
+  for (;;) {
+    for (uint8_t from_cas = 0; from_cas < 2; ++from_cas) {
+      // Rows went unrefreshed while sending, so write the pattern again
+      reset_capture();
+      write_diagonal();
+      memset(&rac_histogram, 0, sizeof(RacHistogram));
+      for (uint8_t sweep = RAC_SWEEPS; sweep != 0; --sweep) {
+        // Read along diagonal
+        uint8_t address = 0;
+        do {
+          const uint8_t count = from_cas ? capture_read<true>(address) : capture_read(address);
+          if (count == 0) fail();
+          count_rac(address, count);
+        } while (++address != 0);
+
+        // Blink green LED between sweeps
+        if ((phase & 0xFF) == 0) {
+          if ((phase >> 8 & 0x03) == 0 && (phase >> 10 & 0x03) < blinks) {
+            PORTB |= LED_G;
+          } else if ((phase >> 8 & 0x03) == 0x02) {
+            PORTB &= ~LED_G;
+          }
+        }
+        ++phase;
+      }
+
+      const uint8_t median = rac_median();
+      if (!from_cas) {
+        const uint16_t ns = counts_to_ns(median);
+        blinks = ns > RAC_MEDIAN_NS ? 3 : ns < RAC_MEDIAN_NS ? 1 : 2;
+      }
+      if (report_rac(from_cas ? PSTR("CAC") : PSTR("RAC"), median) != 0) PORTB |= LED_R;
+    }
+    report_page();
+    map_access(is_256);
+  }
+}
+
+#else
+#error Must define I/O for current chip; see ifdef __AVR_ATmega328P__ above
+#endif
+
+// Read then write (both optional) at one address
+// NOTE Din must already be set for `WRITE`
+template <Read READ, Write WRITE, Bit ROW_A8, Bit COL_A8>
+void read_write(uint8_t row, uint8_t col) {
+  if (READ != RX && read<ROW_A8, COL_A8>(row, col) != READ) {
+    fail(cell_at<ROW_A8, COL_A8>(row, col));
+  }
+  if (WRITE != WX) write<ROW_A8, COL_A8>(row, col);
+}
+
+// Loop over the 8-bit x 8-bit address range, up or down
+// Read then write (both optional) once at each address along the way
+// Up to two more read/write pairs may follow for longer march elements
+// NOTE use the lower byte as the row so a refresh is done at each step
+// Longer elements take too long to get back to each row, so they also poll
+// the refresh scheduler
+template <Direction DIR, Read READ, Write WRITE, Bit ROW_A8 = BitX, Bit COL_A8 = BitX,
+  Read READ2 = RX, Write WRITE2 = WX, Read READ3 = RX, Write WRITE3 = WX>
+void march_once() {
+  if (ROW_A8 == COL_A8 && ROW_A8 != BitX) {
+    // Optimization for non-changing A8 value
+    set_a8<ROW_A8>();
+    march_once<DIR, READ, WRITE, BitX, BitX, READ2, WRITE2, READ3, WRITE3>();
+  } else {
+    // Later pairs change Din, so it must be set again at each address
+    constexpr bool MULTI = READ2 != RX || WRITE2 != WX;
+    uint16_t address = 0;
+    do {
+      if (DIR == DN) --address;
+      const uint8_t col = address >> 8;
+      const uint8_t row = address & 0xFF;
+      if (MULTI && WRITE != WX) set_data<WRITE>();
+      read_write<READ, WRITE, ROW_A8, COL_A8>(row, col);
+      if (MULTI) {
+        if (WRITE2 != WX) set_data<WRITE2>();
+        read_write<READ2, WRITE2, ROW_A8, COL_A8>(row, col);
+        if (WRITE3 != WX) set_data<WRITE3>();
+        read_write<READ3, WRITE3, ROW_A8, COL_A8>(row, col);
+        poll_refresh();
+      }
+      if (DIR == UP) ++address;
+    } while (address != 0);
+  }
+}
+
+// Run `kernel.run<ROW_A8, COL_A8>()` over each A8 quadrant of the chip, in
+// counting order marching up and the reverse marching down
+// The 4164 has no A8, so it runs once with BitX
+template <Chip CHIP, Direction DIR, typename KERNEL>
+void march_quadrants(KERNEL&& kernel) {
+  if (CHIP == DRAM_41256) {
+    if (DIR == UP) {
+      // Increment A8 bits
+      kernel.template run<Bit0, Bit0>();
+      kernel.template run<Bit1, Bit0>();
+      kernel.template run<Bit0, Bit1>();
+      kernel.template run<Bit1, Bit1>();
+    } else {
+      // Decrement A8 bits
+      kernel.template run<Bit1, Bit1>();
+      kernel.template run<Bit0, Bit1>();
+      kernel.template run<Bit1, Bit0>();
+      kernel.template run<Bit0, Bit0>();
+    }
+  } else {
+    kernel.template run<BitX, BitX>();
+  }
+}
+
+// A8 quadrant (row A8 | col A8 << 1) for kernels that set A8 at runtime
+constexpr uint8_t quadrant(Bit row_a8, Bit col_a8) {
+  return (row_a8 == Bit1 ? 0x01 : 0) | (col_a8 == Bit1 ? 0x02 : 0);
+}
+
+// `march_once` over one quadrant for `march_quadrants`
+template <Direction DIR, Read READ, Write WRITE, Read READ2, Write WRITE2, Read READ3, Write WRITE3>
+struct MarchOnce {
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() {
+    march_once<DIR, READ, WRITE, ROW_A8, COL_A8, READ2, WRITE2, READ3, WRITE3>();
+  }
+};
+
+// Perform one step of march algorithm
+template <Chip CHIP, Direction DIR, Read READ, Write WRITE,
+  Read READ2 = RX, Write WRITE2 = WX, Read READ3 = RX, Write WRITE3 = WX>
+void march_step() {
+  // Data is same for all writes, so set Din once outside loop
+  set_data<WRITE>();
+  ++pass_element;
+
+  march_quadrants<CHIP, DIR>(MarchOnce<DIR, READ, WRITE, READ2, WRITE2, READ3, WRITE3>());
+}
+
+// Default unpecified write to WX
+template <Chip CHIP, Direction DIR, Read READ>
+void march_step() {
+  march_step<CHIP, DIR, READ, WX>();
+}
+
+// Default unpecified read to RX
+template <Chip CHIP, Direction DIR, Write WRITE>
+void march_step() {
+  march_step<CHIP, DIR, RX, WRITE>();
+}
+
+// Data background, where Din flips from the written value for cells with
+// (row & row_mask) ^ (col & col_mask) nonzero
+struct Background {
+  uint8_t row_mask;
+  uint8_t col_mask;
+};
+
+// Backgrounds run after solid in MULTI_BACKGROUND mode
+const Background BACKGROUNDS[] = {
+  { 0x01, 0x01 }, // checkerboard
+  { 0x01, 0x00 }, // row stripe
+  { 0x00, 0x01 }, // col stripe
+  { 0xFF, 0xFF }, // diagonal (all but the diagonal flipped)
+};
+
+Background background;
+
+// Same as `march_once`, but with data flipped per cell to draw `background`
+// Costs a few cycles per access over solid data, which stays on `march_once`
+template <Direction DIR, Read READ, Write WRITE, Bit ROW_A8 = BitX, Bit COL_A8 = BitX>
+void march_background_once() {
+  if (ROW_A8 == COL_A8 && ROW_A8 != BitX) {
+    // Optimization for non-changing A8 value
+    set_a8<ROW_A8>();
+    march_background_once<DIR, READ, WRITE>();
+  } else {
+    const Background bg = background;
+    uint16_t address = 0;
+    do {
+      if (DIR == DN) --address;
+      const uint8_t col = address >> 8;
+      const uint8_t row = address & 0xFF;
+      const bool flip = ((row & bg.row_mask) ^ (col & bg.col_mask)) != 0;
+      if (READ != RX) {
+        // R1 is the Dout bit, so flip expected value with xor
+        const Read expected = flip ? Read(READ ^ DOUT) : READ;
+        if (read<ROW_A8, COL_A8>(row, col) != expected) {
+          fail(cell_at<ROW_A8, COL_A8>(row, col));
+        }
+      }
+      if (WRITE != WX) {
+        if (flip == (WRITE == W0)) {
+          PORTB |= DIN;
+        } else {
+          PORTB &= ~DIN;
+        }
+        write<ROW_A8, COL_A8>(row, col);
+      }
+      if (DIR == UP) ++address;
+    } while (address != 0);
+  }
+}
+
+// `march_background_once` over one quadrant for `march_quadrants`
+template <Direction DIR, Read READ, Write WRITE>
+struct MarchBackgroundOnce {
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() { march_background_once<DIR, READ, WRITE, ROW_A8, COL_A8>(); }
+};
+
+// Perform one step of march algorithm over `background`
+template <Chip CHIP, Direction DIR, Read READ, Write WRITE>
+void march_background_step() {
+  ++pass_element;
+  march_quadrants<CHIP, DIR>(MarchBackgroundOnce<DIR, READ, WRITE>());
+}
+
+// Read then write (both optional) at `address` in the given order
+template <Order ORDER, Read READ, Write WRITE, Bit ROW_A8, Bit COL_A8>
+void order_read_write(uint16_t address) {
+  const uint8_t row = ORDER == COLUMN_FAST ? address >> 8 : address & 0xFF;
+  const uint8_t col = ORDER == COLUMN_FAST ? address & 0xFF : address >> 8;
+  read_write<READ, WRITE, ROW_A8, COL_A8>(row, col);
+  if (ORDER == COLUMN_FAST || ORDER == RANDOM) poll_refresh();
+}
+
+// Same as `march_once` but in the given address order, where marching down
+// exactly reverses marching up
+template <Order ORDER, Direction DIR, Read READ, Write WRITE, Bit ROW_A8 = BitX, Bit COL_A8 = BitX>
+void march_order_once() {
+  if (ROW_A8 == COL_A8 && ROW_A8 != BitX) {
+    // Optimization for non-changing A8 value
+    set_a8<ROW_A8>();
+    march_order_once<ORDER, DIR, READ, WRITE>();
+  } else if (ORDER == COMPLEMENT) {
+    // Visit pairs of `i` and `~i`, covering the top half with the complements
+    uint16_t i = DIR == UP ? 0 : 0x8000;
+    do {
+      if (DIR == UP) {
+        order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(i);
+        order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(~i);
+        ++i;
+      } else {
+        --i;
+        order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(~i);
+        order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(i);
+      }
+    } while (i != (DIR == UP ? 0x8000 : 0));
+  } else if (ORDER == RANDOM) {
+    // LFSR never reaches 0, so visit it at the start (or end, marching down)
+    if (DIR == UP) order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(0);
+    uint16_t state = 1;
+    do {
+      if (DIR == DN) state = lfsr16_prev(state);
+      order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(state);
+      if (DIR == UP) state = lfsr16_next(state);
+    } while (state != 1);
+    if (DIR == DN) order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(0);
+  } else {
+    uint16_t i = 0;
+    do {
+      if (DIR == DN) --i;
+      order_read_write<ORDER, READ, WRITE, ROW_A8, COL_A8>(ORDER == GRAY ? i ^ i >> 1 : i);
+      if (DIR == UP) ++i;
+    } while (i != 0);
+  }
+}
+
+// `march_order_once` over one quadrant for `march_quadrants`
+template <Order ORDER, Direction DIR, Read READ, Write WRITE>
+struct MarchOrderOnce {
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() { march_order_once<ORDER, DIR, READ, WRITE, ROW_A8, COL_A8>(); }
+};
+
+// Perform one step of march algorithm in the given address order
+template <Chip CHIP, Order ORDER, Direction DIR, Read READ, Write WRITE>
+void march_order_step() {
+  // Data is same for all writes, so set Din once outside loop
+  set_data<WRITE>();
+  ++pass_element;
+
+  march_quadrants<CHIP, DIR>(MarchOrderOnce<ORDER, DIR, READ, WRITE>());
+}
+
+// Same as `march_once` but stepping by `step` (a power of 2), moving on to the
+// next offset each time the address wraps around, so every address is still
+// visited once and marching down exactly reverses marching up
+// Rows are left for too long with larger steps, so this polls the refresh scheduler
+template <Direction DIR, Read READ, Write WRITE, Bit ROW_A8 = BitX, Bit COL_A8 = BitX>
+void march_movi_once(uint16_t step) {
+  if (ROW_A8 == COL_A8 && ROW_A8 != BitX) {
+    // Optimization for non-changing A8 value
+    set_a8<ROW_A8>();
+    march_movi_once<DIR, READ, WRITE>(step);
+  } else {
+    uint16_t address = DIR == UP ? 0 : 0xFFFF;
+    uint16_t count = 0;
+    do {
+      const uint8_t col = address >> 8;
+      const uint8_t row = address & 0xFF;
+      read_write<READ, WRITE, ROW_A8, COL_A8>(row, col);
+      poll_refresh();
+      if (DIR == UP) {
+        const uint16_t next = address + step;
+        address = next < address ? next + 1 : next;
+      } else {
+        const uint16_t next = address - step;
+        address = next > address ? next - 1 : next;
+      }
+    } while (++count != 0);
+  }
+}
+
+// `march_movi_once` over one quadrant for `march_quadrants`
+template <Direction DIR, Read READ, Write WRITE>
+struct MarchMoviOnce {
+  uint16_t step;
+
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() { march_movi_once<DIR, READ, WRITE, ROW_A8, COL_A8>(step); }
+};
+
+// Same as `march_once` but with A8 changing fastest, visiting all 4 quadrants
+// at each address, with either the row or col A8 bit as the lowest bit
+template <Direction DIR, Read READ, Write WRITE, bool COL_FIRST>
+void march_a8_once() {
+  // Second and third quadrants in counting order
+  constexpr Bit ROW_Q1 = COL_FIRST ? Bit0 : Bit1;
+  constexpr Bit COL_Q1 = COL_FIRST ? Bit1 : Bit0;
+  uint16_t address = 0;
+  do {
+    if (DIR == DN) --address;
+    const uint8_t col = address >> 8;
+    const uint8_t row = address & 0xFF;
+    if (DIR == UP) {
+      read_write<READ, WRITE, Bit0, Bit0>(row, col);
+      read_write<READ, WRITE, ROW_Q1, COL_Q1>(row, col);
+      read_write<READ, WRITE, COL_Q1, ROW_Q1>(row, col);
+      read_write<READ, WRITE, Bit1, Bit1>(row, col);
+    } else {
+      read_write<READ, WRITE, Bit1, Bit1>(row, col);
+      read_write<READ, WRITE, COL_Q1, ROW_Q1>(row, col);
+      read_write<READ, WRITE, ROW_Q1, COL_Q1>(row, col);
+      read_write<READ, WRITE, Bit0, Bit0>(row, col);
+    }
+    poll_refresh();
+    if (DIR == UP) ++address;
+  } while (address != 0);
+}
+
+// Perform one step of march algorithm with address increment 2^`shift`
+// Shifts 16 and 17 increment the row and col A8 bits of the 41256
+template <Chip CHIP, Direction DIR, Read READ, Write WRITE>
+void march_movi_step(uint8_t shift) {
+  // Data is same for all writes, so set Din once outside loop
+  set_data<WRITE>();
+  ++pass_element;
+
+  if (CHIP == DRAM_41256 && shift == 16) {
+    march_a8_once<DIR, READ, WRITE, false>();
+  } else if (CHIP == DRAM_41256 && shift == 17) {
+    march_a8_once<DIR, READ, WRITE, true>();
+  } else {
+    march_quadrants<CHIP, DIR>(MarchMoviOnce<DIR, READ, WRITE> { uint16_t(1 << shift) });
+  }
+}
+
+// Run one pass of march C- algorithm
+template <Chip CHIP>
+void march_c() {
+  march_step<CHIP, UP, W0>();
+  march_step<CHIP, UP, R0, W1>();
+  march_step<CHIP, UP, R1, W0>();
+  march_step<CHIP, DN, R0, W1>();
+  march_step<CHIP, DN, R1, W0>();
+  march_step<CHIP, DN, R0>();
+}
+
+// Run one pass of march C- algorithm in the given address order
+template <Chip CHIP, Order ORDER>
+void march_c_order() {
+  march_order_step<CHIP, ORDER, UP, RX, W0>();
+  march_order_step<CHIP, ORDER, UP, R0, W1>();
+  march_order_step<CHIP, ORDER, UP, R1, W0>();
+  march_order_step<CHIP, ORDER, DN, R0, W1>();
+  march_order_step<CHIP, ORDER, DN, R1, W0>();
+  march_order_step<CHIP, ORDER, DN, R0, WX>();
+}
+
+// Run one pass of march C- algorithm with address increment 2^`shift`
+template <Chip CHIP>
+void march_c_movi(uint8_t shift) {
+  march_movi_step<CHIP, UP, RX, W0>(shift);
+  march_movi_step<CHIP, UP, R0, W1>(shift);
+  march_movi_step<CHIP, UP, R1, W0>(shift);
+  march_movi_step<CHIP, DN, R0, W1>(shift);
+  march_movi_step<CHIP, DN, R1, W0>(shift);
+  march_movi_step<CHIP, DN, R0, WX>(shift);
+}
+
+// Run one pass of march C- algorithm over `background`
+template <Chip CHIP>
+void march_c_background() {
+  march_background_step<CHIP, UP, RX, W0>();
+  march_background_step<CHIP, UP, R0, W1>();
+  march_background_step<CHIP, UP, R1, W0>();
+  march_background_step<CHIP, DN, R0, W1>();
+  march_background_step<CHIP, DN, R1, W0>();
+  march_background_step<CHIP, DN, R0, WX>();
+}
+
+// Run one pass of MATS+ algorithm (5n)
+// Catches address decoder and stuck-at faults in half the time of march C-
+template <Chip CHIP>
+void mats_plus() {
+  march_step<CHIP, UP, W0>();
+  march_step<CHIP, UP, R0, W1>();
+  march_step<CHIP, DN, R1, W0>();
+}
+
+// Run one pass of march B algorithm (17n)
+// Adds linked coupling faults to what march C- detects
+template <Chip CHIP>
+void march_b() {
+  march_step<CHIP, UP, W0>();
+  march_step<CHIP, UP, R0, W1, R1, W0, R0, W1>();
+  march_step<CHIP, UP, R1, W0, RX, W1>();
+  march_step<CHIP, DN, R1, W0, RX, W1, RX, W0>();
+  march_step<CHIP, DN, R0, W1, RX, W0>();
+}
+
+// Loop over the address range a page at a time, up or down
+// Each page holds RAS low while 4 columns are read then written (both
+// optional) with the given access mode, short enough to stay inside tRAS max
+// Pages step through rows first, so rows are still refreshed as they go
+// NOTE nibble pages cover all 4 A8 quadrants in the chip's counter order, even
+// marching down, so `a8` is only used by page and static column modes
+template <Access ACCESS, Direction DIR, Read READ, Write WRITE>
+void march_page_once(uint8_t a8) {
+  // Row in low byte, then column (nibble) or group of 4 columns in high bits
+  constexpr uint16_t PAGES = ACCESS == NIBBLE ? 0 : 0x4000;
+  uint16_t page = DIR == UP ? 0 : PAGES;
+  do {
+    if (DIR == DN) --page;
+    const uint8_t row = page & 0xFF;
+    const uint8_t col = ACCESS == NIBBLE ? page >> 8 : page >> 6 & 0xFC;
+    open_page<ACCESS>(row, col, a8);
+    uint8_t failed = 0;
+    for (uint8_t step = 0; step < 4; ++step) {
+      // Nibble steps always follow the chip's counter
+      const uint8_t offset = DIR == UP || ACCESS == NIBBLE ? step : 3 - step;
+      if (page_step<ACCESS, READ, WRITE>(col + offset)) failed |= bit_mask(offset);
+    }
+    PORTC = CTRL_DEFAULT;
+    // Report failures after RAS is high again
+    for (uint8_t offset = 0; failed != 0; ++offset, failed >>= 1) {
+      if ((failed & 1) == 0) continue;
+      if (ACCESS == NIBBLE) {
+        const uint8_t quadrant = nibble_order[offset];
+        fail(Cell { uint16_t(row | (quadrant << 8 & 0x100)), uint16_t(col | (quadrant << 7 & 0x100)) });
+      } else {
+        fail(Cell { uint16_t(row | (a8 << 8 & 0x100)), uint16_t((col + offset) | (a8 << 7 & 0x100)) });
+      }
+    }
+    if (DIR == UP) ++page;
+  } while (page != (DIR == UP ? PAGES : 0));
+}
+
+// `march_page_once` over one quadrant for `march_quadrants`
+template <Access ACCESS, Direction DIR, Read READ, Write WRITE>
+struct MarchPageOnce {
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() { march_page_once<ACCESS, DIR, READ, WRITE>(quadrant(ROW_A8, COL_A8)); }
+};
+
+// Perform one step of march algorithm with a fast access mode
+template <Chip CHIP, Access ACCESS, Direction DIR, Read READ, Write WRITE>
+void march_page_step() {
+  // Data is same for all writes, so set Din once outside loop
+  set_data<WRITE>();
+  ++pass_element;
+
+  if (ACCESS == NIBBLE) {
+    march_page_once<ACCESS, DIR, READ, WRITE>(0);
+  } else {
+    march_quadrants<CHIP, DIR>(MarchPageOnce<ACCESS, DIR, READ, WRITE>());
+  }
+}
+
+// Hold 0s then 1s for `settings.pause_ms` with refresh off, checking cells keep them
+template <Chip CHIP>
+void retention() {
+  march_step<CHIP, UP, W0>();
+  refresh_hold_ms(NO_REFRESH, settings.pause_ms);
+  march_step<CHIP, UP, R0, W1>();
+  refresh_hold_ms(NO_REFRESH, settings.pause_ms);
+  march_step<CHIP, UP, R1>();
+}
+
+// Run one pass of march C- algorithm with a fast access mode
+template <Chip CHIP, Access ACCESS>
+void march_c_fast() {
+  march_page_step<CHIP, ACCESS, UP, RX, W0>();
+  march_page_step<CHIP, ACCESS, UP, R0, W1>();
+  march_page_step<CHIP, ACCESS, UP, R1, W0>();
+  march_page_step<CHIP, ACCESS, DN, R0, W1>();
+  march_page_step<CHIP, ACCESS, DN, R1, W0>();
+  march_page_step<CHIP, ACCESS, DN, R0, WX>();
+}
+
+// Fastest access mode supported by the chip, if FAST_MODE is set
+Access fast_access = NORMAL;
+
+// Detect fast access modes and report them
+// Picks the one to use for march C- if FAST_MODE is set
+template <Chip CHIP>
+void detect_access() {
+  const bool page = has_page_mode();
+  const bool static_column = has_static_column();
+  const bool nibble = CHIP == DRAM_41256 && has_nibble_mode();
+  if (FAST_MODE) {
+    fast_access = nibble ? NIBBLE : static_column ? STATIC_COLUMN : page ? PAGE : NORMAL;
+  }
+
+  serial_begin();
+  serial_print_P(PSTR("MODES"));
+  serial_field_P(PSTR("page"), page);
+  serial_field_P(PSTR("static_column"), static_column);
+  serial_field_P(PSTR("nibble"), nibble);
+  if (nibble) {
+    serial_print_P(PSTR(" nibble_order="));
+    for (uint8_t step = 0; step < 4; ++step) serial_write('0' + nibble_order[step]);
+  }
+  serial_end();
+}
+
+// Start of the LFSR data stream for the next RANDOM_DATA pass
+// Each pass carries on from where the last one ended, so it writes a new pattern
+uint32_t random_seed = 1;
+
+// Write the next bit of the LFSR data stream at `address`, or verify it
+// Returns the next LFSR state
+template <bool VERIFY, Bit ROW_A8, Bit COL_A8>
+uint32_t random_access(uint16_t address, uint32_t data) {
+  const uint8_t col = address >> 8;
+  const uint8_t row = address & 0xFF;
+  if (VERIFY) {
+    if ((read<ROW_A8, COL_A8>(row, col) != R0) != ((data & 1) != 0)) {
+      fail(cell_at<ROW_A8, COL_A8>(row, col));
+    }
+  } else {
+    if ((data & 1) != 0) {
+      PORTB |= DIN;
+    } else {
+      PORTB &= ~DIN;
+    }
+    write<ROW_A8, COL_A8>(row, col);
+  }
+  return lfsr32_next(data);
+}
+
+// Loop over the 8-bit x 8-bit address range writing or verifying the LFSR data
+// stream from `data`, in linear order or shuffled by the 16-bit address LFSR
+// Returns the LFSR state after the last address
+template <bool VERIFY, bool SHUFFLE, Bit ROW_A8 = BitX, Bit COL_A8 = BitX>
+uint32_t random_data_once(uint32_t data) {
+  if (ROW_A8 == COL_A8 && ROW_A8 != BitX) {
+    // Optimization for non-changing A8 value
+    set_a8<ROW_A8>();
+    return random_data_once<VERIFY, SHUFFLE>(data);
+  } else if (SHUFFLE) {
+    // Address LFSR never reaches 0, so visit it first
+    data = random_access<VERIFY, ROW_A8, COL_A8>(0, data);
+    uint16_t address = 1;
+    do {
+      data = random_access<VERIFY, ROW_A8, COL_A8>(address, data);
+      poll_refresh();
+      address = lfsr16_next(address);
+    } while (address != 1);
+  } else {
+    uint16_t address = 0;
+    do {
+      data = random_access<VERIFY, ROW_A8, COL_A8>(address, data);
+    } while (++address != 0);
+  }
+  return data;
+}
+
+// `random_data_once` over one quadrant for `march_quadrants`, carrying the
+// LFSR state from one quadrant to the next
+template <bool VERIFY>
+struct RandomDataOnce {
+  uint32_t data;
+
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() { data = random_data_once<VERIFY, RANDOM_DATA == 2, ROW_A8, COL_A8>(data); }
+};
+
+// Write or verify the LFSR data stream from `data` over the whole chip
+template <Chip CHIP, bool VERIFY>
+uint32_t random_data_step(uint32_t data) {
+  ++pass_element;
+  RandomDataOnce<VERIFY> kernel { data };
+  march_quadrants<CHIP, UP>(kernel);
+  return kernel.data;
+}
+
+// Fill the chip with pseudo-random data, then regenerate the stream to verify
+template <Chip CHIP>
+void random_data() {
+  random_data_step<CHIP, false>(random_seed);
+  random_seed = random_data_step<CHIP, true>(random_seed);
+}
+
+// Address increments in MOVI_MODE, after the usual increment of 1
+template <Chip CHIP>
+constexpr uint8_t movi_shifts() {
+  return CHIP == DRAM_41256 ? 18 : 16;
+}
+
+// Time taken by the larger increments in the last pass
+uint32_t movi_ms;
+
+// Run march C- with each larger address increment, timing the whole sweep
+template <Chip CHIP>
+void march_c_movi_sweep() {
+  const uint32_t start = stopwatch_ticks();
+  for (uint8_t shift = 1; shift < movi_shifts<CHIP>(); ++shift) {
+    march_c_movi<CHIP>(shift);
+  }
+  movi_ms = ticks_to_ms(stopwatch_ticks() - start);
+}
+
+// Run one pass of march C- with the selected access mode
+// then over the other backgrounds if MULTI_BACKGROUND is set
+// then with larger address increments if MOVI_MODE is set
+// then with pseudo-random data if RANDOM_DATA is set
+template <Chip CHIP>
+void run_march_c() {
+  // Only build the fast variants when they can be selected
+  switch (FAST_MODE ? fast_access : NORMAL) {
+  case PAGE: march_c_fast<CHIP, PAGE>(); break;
+  case STATIC_COLUMN: march_c_fast<CHIP, STATIC_COLUMN>(); break;
+  case NIBBLE: march_c_fast<CHIP, NIBBLE>(); break;
+  default:
+    if (ADDRESS_ORDER == LINEAR) {
+      march_c<CHIP>();
+    } else {
+      march_c_order<CHIP, Order(ADDRESS_ORDER)>();
+    }
+    break;
+  }
+  if (MULTI_BACKGROUND) {
+    for (const Background& bg : BACKGROUNDS) {
+      background = bg;
+      march_c_background<CHIP>();
+    }
+  }
+  if (MOVI_MODE) march_c_movi_sweep<CHIP>();
+  if (RANDOM_DATA) random_data<CHIP>();
+}
+
+// Run the configured algorithm
+// Tiered passes stop at the first tier that fails, so dead chips are rejected
+// after the quick MATS+ pre-screen
+template <Chip CHIP>
+void run_tiers() {
+  if (settings.algorithm == MARCH_C) {
+    run_march_c<CHIP>();
+    return;
+  }
+  mats_plus<CHIP>();
+  if (pass_failed) return;
+  run_march_c<CHIP>();
+  if (pass_failed || settings.algorithm != TIERED_MARCH_B) return;
+  march_b<CHIP>();
+}
+
+// Run one pass of the configured algorithm, then the retention hold if set
+template <Chip CHIP>
+void run_pass() {
+  pass_failed = false;
+  pass_element = 0;
+  memset(&fail_map, 0, sizeof(FailMap));
+  run_tiers<CHIP>();
+  if (settings.pause_ms != 0 && !pass_failed) retention<CHIP>();
+  if (FAIL_STREAM) flush_stream();
+}
+
+// Send " key_row=... key_col=..." report fields
+void report_cell_P(const char* key, Cell cell) {
+  serial_write(' ');
+  serial_print_P(key);
+  serial_print_P(PSTR("_row="));
+  serial_print(cell.row);
+  serial_write(' ');
+  serial_print_P(key);
+  serial_print_P(PSTR("_col="));
+  serial_print(cell.col);
+}
+
+// Send soak test statistics as report fields
+void report_stats_fields(const Stats& stats) {
+  serial_field_P(PSTR("passes"), stats.passes);
+  serial_field_P(PSTR("failed_passes"), stats.failed_passes);
+  serial_field_P(PSTR("failed_reads"), stats.failed_reads);
+  if (stats.failed_reads != 0) {
+    serial_field_P(PSTR("first_pass"), stats.first_fail_pass);
+    report_cell_P(PSTR("first"), stats.first_fail);
+    serial_field_P(PSTR("last_pass"), stats.last_fail_pass);
+    report_cell_P(PSTR("last"), stats.last_fail);
+  }
+}
+
+// Send time taken by the larger MOVI increments, which is added to every pass
+template <Chip CHIP>
+void report_movi() {
+  serial_begin();
+  serial_print_P(PSTR("MOVI"));
+  serial_field_P(PSTR("increments"), movi_shifts<CHIP>() - 1);
+  serial_field_P(PSTR("ms"), movi_ms);
+  serial_end();
+}
+
+// Rows or cols per chip, including A8
+constexpr uint16_t chip_lines(Chip chip) {
+  return chip == DRAM_41256 ? 512 : 256;
+}
+
+// Estimated CPU cycles per access of a march kernel, for the pass budget
+// Strobes come from the edge counts, so they follow the delays for F_CPU
+struct KernelCycles {
+  uint8_t read; // strobes of a read
+  uint8_t write; // strobes of a write
+  uint8_t loop; // address, data, fail check and refresh polling, per access
+};
+
+// `read` and `write`: OUT row address, RAS falls, then the edges counted above
+constexpr uint8_t READ_ACCESS_CYCLES = 2 * OUT_CYCLES + RCD_CYCLES + READ_CAS_CYCLES;
+constexpr uint8_t WRITE_ACCESS_CYCLES = 2 * OUT_CYCLES + RCD_CYCLES + WRITE_CAS_CYCLES;
+// `page_step`: OUT col address, CAS falls, read and (late) write edges, with
+// CAS rising after CAS_DELAY either way
+constexpr uint8_t PAGE_READ_CYCLES = 2 * OUT_CYCLES + READ_DELAY + OUT_CYCLES;
+constexpr uint8_t PAGE_WRITE_CYCLES = OUT_CYCLES + WRITE_CAS_CYCLES;
+
+// Loop of `march_once`, from the 1.3s (4164) and 7.5s (41256) march C- passes
+// at 16 MHz less their strobes; the 41256 also switches A8 and forms 9-bit cells
+constexpr uint8_t march_loop_cycles(Chip chip) {
+  return chip == DRAM_41256 ? 38 : 24;
+}
+
+// Cycles each kernel adds to the loop of `march_once`, from its extra instructions
+constexpr uint8_t POLL_CYCLES = 3; // `poll_refresh` with no burst due
+constexpr uint8_t GRAY_CYCLES = 5; // i ^ i >> 1
+constexpr uint8_t COMPLEMENT_CYCLES = 2; // ~i
+constexpr uint8_t LFSR16_CYCLES = 7; // `lfsr16_next`
+constexpr uint8_t LFSR32_CYCLES = 12; // `lfsr32_next`
+constexpr uint8_t DIN_CYCLES = 3; // Din from a runtime bit
+constexpr uint8_t BACKGROUND_CYCLES = 5 + DIN_CYCLES; // flip from the masks
+constexpr uint8_t MOVI_CYCLES = 10 + POLL_CYCLES; // step, wrap and count
+constexpr uint8_t MULTI_CYCLES = 2; // march B: Din for each read/write pair
+// `march_page_once`: page loop, `open_page` shared by 4 columns, and fail bits
+constexpr uint8_t PAGE_LOOP_CYCLES = 12;
+
+// Cycles of `march_once`, plus `extra` per access
+template <Chip CHIP>
+constexpr KernelCycles march_kernel(uint8_t extra = 0) {
+  return KernelCycles { READ_ACCESS_CYCLES, WRITE_ACCESS_CYCLES, uint8_t(march_loop_cycles(CHIP) + extra) };
+}
+
+// Cycles `march_order_once` adds for each address order
+constexpr uint8_t order_cycles(Order order) {
+  return order == GRAY ? GRAY_CYCLES :
+    order == COMPLEMENT ? COMPLEMENT_CYCLES :
+    order == COLUMN_FAST ? POLL_CYCLES :
+    order == RANDOM ? LFSR16_CYCLES + POLL_CYCLES : 0;
+}
+
+// Cycles per cell of march elements with `reads` and `writes` in total
+constexpr uint32_t element_cycles(KernelCycles kernel, uint8_t reads, uint8_t writes) {
+  return uint32_t(reads) * (kernel.read + kernel.loop) + uint32_t(writes) * (kernel.write + kernel.loop);
+}
+
+// Cycles per cell of a full pass of the configured tests (all tiers passing),
+// adding up the elements of each that runs
+template <Chip CHIP>
+uint32_t pass_cell_cycles() {
+  // March C-: 5 reads and 5 writes per cell, in the selected access mode
+  uint32_t cycles;
+  if (FAST_MODE && fast_access != NORMAL) {
+    cycles = element_cycles(KernelCycles { PAGE_READ_CYCLES, PAGE_WRITE_CYCLES, PAGE_LOOP_CYCLES }, 5, 5);
+  } else {
+    cycles = element_cycles(march_kernel<CHIP>(order_cycles(Order(ADDRESS_ORDER))), 5, 5);
+  }
+  if (MULTI_BACKGROUND) {
+    cycles += sizeof(BACKGROUNDS) / sizeof(Background) *
+      element_cycles(march_kernel<CHIP>(BACKGROUND_CYCLES), 5, 5);
+  }
+  if (MOVI_MODE) {
+    cycles += (movi_shifts<CHIP>() - 1) * element_cycles(march_kernel<CHIP>(MOVI_CYCLES), 5, 5);
+  }
+  if (RANDOM_DATA) {
+    // One write and one read of the LFSR data stream
+    constexpr uint8_t SHUFFLE_CYCLES = RANDOM_DATA == 2 ? LFSR16_CYCLES + POLL_CYCLES : 0;
+    cycles += element_cycles(march_kernel<CHIP>(LFSR32_CYCLES + DIN_CYCLES + SHUFFLE_CYCLES), 1, 1);
+  }
+  // MATS+: 2 reads and 3 writes
+  if (settings.algorithm != MARCH_C) cycles += element_cycles(march_kernel<CHIP>(), 2, 3);
+  // March B: 6 reads and 11 writes, polling refresh at each address
+  if (settings.algorithm == TIERED_MARCH_B) {
+    cycles += element_cycles(march_kernel<CHIP>(MULTI_CYCLES + POLL_CYCLES), 6, 11);
+  }
+  // Retention: 2 reads and 2 writes
+  if (settings.pause_ms != 0) cycles += element_cycles(march_kernel<CHIP>(), 2, 2);
+  return cycles;
+}
+
+// Longest a pass should take, with 25% margin for refresh and failure
+// handling, plus the retention holds
+template <Chip CHIP>
+uint32_t pass_budget_ms() {
+  const uint64_t cycles = uint64_t(chip_lines(CHIP)) * chip_lines(CHIP) * pass_cell_cycles<CHIP>();
+  return cycles * 5 / 4 / (F_CPU / 1000) + 2 * uint32_t(settings.pause_ms);
+}
+
+// Duration of passes, to catch a fixture or build that has slowed down
+struct PassTimes {
+  uint32_t last_ms;
+  uint32_t min_ms;
+  uint32_t max_ms;
+  uint32_t total_ms;
+  uint16_t slow_passes; // over `pass_budget_ms`
+};
+
+PassTimes pass_times;
+
+// Add duration of the pass just counted by `count_pass`
+template <Chip CHIP>
+void count_pass_time(uint32_t ms) {
+  pass_times.last_ms = ms;
+  if (stats.passes == 1 || ms < pass_times.min_ms) pass_times.min_ms = ms;
+  if (ms > pass_times.max_ms) pass_times.max_ms = ms;
+  pass_times.total_ms += ms;
+  if (ms > pass_budget_ms<CHIP>()) ++pass_times.slow_passes;
+}
+
+// Send pass duration statistics and the expected budget
+// slow=1 flags a pass over budget
+template <Chip CHIP>
+void report_pass_times() {
+  serial_begin();
+  serial_print_P(PSTR("TIME"));
+  serial_field_P(PSTR("ms"), pass_times.last_ms);
+  serial_field_P(PSTR("min_ms"), pass_times.min_ms);
+  serial_field_P(PSTR("max_ms"), pass_times.max_ms);
+  serial_field_P(PSTR("mean_ms"), pass_times.total_ms / stats.passes);
+  serial_field_P(PSTR("budget_ms"), pass_budget_ms<CHIP>());
+  serial_field_P(PSTR("slow"), pass_times.last_ms > pass_budget_ms<CHIP>());
+  serial_field_P(PSTR("slow_passes"), pass_times.slow_passes);
+  serial_end();
+}
+
+// Send soak test statistics
+// Sent after every pass so a monitor can read them at any time
+void report_stats() {
+  serial_begin();
+  serial_print_P(PSTR("STATS"));
+  report_stats_fields(stats);
+  serial_end();
+}
+
+// Send " index:count" for each nonzero 4-bit count
+void report_counts(const uint8_t* counts) {
+  for (uint16_t index = 0; index < MAP_LINES; ++index) {
+    const uint8_t count = counts[index / 2] >> (index % 2 * 4) & 0x0F;
+    if (count == 0) continue;
+    serial_write(' ');
+    serial_print(index);
+    serial_write(':');
+    serial_print(count);
+  }
+}
+
+// Send failure bitmap of the last pass
+// MAP_ROWS and MAP_COLS list failed reads per row and col (15 means 15 or more)
+// MAP_RUNS lists failing cells as "row,col,length", the run going down the col
+// from `row`
+void report_fail_map() {
+  serial_begin();
+  serial_print_P(PSTR("MAP"));
+  serial_field_P(PSTR("pass"), stats.passes);
+  serial_field_P(PSTR("runs"), fail_map.run_count);
+  serial_field_P(PSTR("overflow"), fail_map.overflow);
+  serial_print_P(PSTR("\nMAP_ROWS"));
+  report_counts(fail_map.row_counts);
+  serial_print_P(PSTR("\nMAP_COLS"));
+  report_counts(fail_map.col_counts);
+  serial_print_P(PSTR("\nMAP_RUNS"));
+  for (uint8_t i = 0; i < fail_map.run_count; ++i) {
+    const FailRun& run = fail_map.runs[i];
+    serial_write(' ');
+    serial_print(run.start.row);
+    serial_write(',');
+    serial_print(run.start.col);
+    serial_write(',');
+    serial_print(run.length);
+  }
+  serial_end();
+}
+
+// Time to leave data with only the refresh under test
+// Much longer than the 4ms spec so cells in rows that are missed lose data
+constexpr uint16_t CBR_HOLD_MS = 8000;
+
+// Rows that lost data, by refresh address A0-A7
+struct LostRows {
+  uint8_t mask[256 / 8];
+  uint16_t count;
+};
+
+// Write column stripes so each row holds both 0s and 1s, whichever way it decays
+template <Chip CHIP>
+void write_stripes() {
+  for (uint16_t col = 0; col < chip_lines(CHIP); ++col) {
+    if ((col & 1) == 0) {
+      set_data<W0>();
+    } else {
+      set_data<W1>();
+    }
+    for (uint16_t row = 0; row < chip_lines(CHIP); ++row) {
+      write_cell(Cell { row, col });
+    }
+  }
+}
+
+// Read back column stripes, noting rows that lost data without signaling failure
+template <Chip CHIP>
+void find_lost_rows(LostRows& lost) {
+  memset(&lost, 0, sizeof(LostRows));
+  for (uint16_t col = 0; col < chip_lines(CHIP); ++col) {
+    const Read expected = (col & 1) == 0 ? R0 : R1;
+    for (uint16_t row = 0; row < chip_lines(CHIP); ++row) {
+      if (read_cell(Cell { row, col }) == expected) continue;
+      uint8_t& byte = lost.mask[(row & 0xFF) / 8];
+      const uint8_t bit = bit_mask(row % 8);
+      if ((byte & bit) == 0) {
+        byte |= bit;
+        ++lost.count;
+      }
+    }
+  }
+}
+
+// Write stripes, wait with only the given refresh, and find rows that lost data
+template <Chip CHIP>
+void hold_stripes(Refresh refresh, LostRows& lost) {
+  write_stripes<CHIP>();
+  refresh_hold_ms(refresh, CBR_HOLD_MS);
+  find_lost_rows<CHIP>(lost);
+}
+
+// Test that the internal refresh counter reaches all 256 rows
+// Holds data with no refresh (to prove the hold is long enough to lose data),
+// then RAS-only refresh (to rule out retention faults), then CBR refresh only
+// Reports rows lost in each case and lists rows the counter missed
+template <Chip CHIP>
+void test_cbr_counter() {
+  LostRows lost;
+  hold_stripes<CHIP>(NO_REFRESH, lost);
+  const uint16_t unrefreshed = lost.count;
+  hold_stripes<CHIP>(RAS_ONLY, lost);
+  const uint16_t ras_only = lost.count;
+  hold_stripes<CHIP>(CAS_BEFORE_RAS, lost);
+
+  const bool failed = ras_only != 0 || lost.count != 0;
+  if (failed) {
+    fail();
+    PORTC = CTRL_DEFAULT;
+  }
+
+  serial_begin();
+  serial_print_P(PSTR("CBR result="));
+  if (failed) {
+    serial_print_P(PSTR("FAIL"));
+  } else if (unrefreshed == 0) {
+    // Cells held data for the whole hold without refresh, so nothing was proven
+    serial_print_P(PSTR("INCONCLUSIVE"));
+  } else {
+    serial_print_P(PSTR("PASS"));
+  }
+  serial_field_P(PSTR("hold_ms"), CBR_HOLD_MS);
+  serial_field_P(PSTR("unrefreshed_rows"), unrefreshed);
+  serial_field_P(PSTR("ras_rows"), ras_only);
+  serial_field_P(PSTR("cbr_rows"), lost.count);
+  if (lost.count != 0) {
+    serial_print_P(PSTR("\nCBR_ROWS"));
+    for (uint16_t row = 0; row < 256; ++row) {
+      if ((lost.mask[row / 8] & bit_mask(row % 8)) == 0) continue;
+      serial_write(' ');
+      serial_print(row);
+    }
+  }
+  serial_end();
+}
+
+// Read then write (or read again for WX) at one address, with RAS high for
+// only PRECHARGE + 1 cycles in between, to stress tRP
+// The row address for the second cycle is set while CAS is still low, so
+// nothing else runs during precharge
+// A8 quadrant is row A8 | col A8 << 1, set at runtime to keep the variants small
+// Timed like `read` and `write`, with RCD_CYCLES plus runtime A8
+// NOTE Din must already be set for `WRITE`
+// Returns true if a read failed
+template <Read READ, Write WRITE, uint8_t PRECHARGE>
+bool precharge_pair(uint8_t row, uint8_t col, uint8_t a8) {
+  PORTD = row;
+  set_a8(a8 & 0x01);
+  PORTC = CTRL_READ_ROW;
+  PORTD = col;
+  set_a8(a8 & 0x02);
+  PORTC = CTRL_READ_COL;
+  delay_cycles<READ_DELAY>();
+  const Read first = Read(PINB & DOUT);
+  PORTD = row;
+  set_a8(a8 & 0x01);
+  PORTC = CTRL_DEFAULT;
+  delay_cycles<PRECHARGE>();
+  Read second = READ;
+  if (WRITE == WX) {
+    PORTC = CTRL_READ_ROW;
+    PORTD = col;
+    set_a8(a8 & 0x02);
+    PORTC = CTRL_READ_COL;
+    delay_cycles<READ_DELAY>();
+    second = Read(PINB & DOUT);
+  } else {
+    PORTC = CTRL_WRITE_ROW;
+    PORTD = col;
+    set_a8(a8 & 0x02);
+    PORTC = CTRL_WRITE_COL;
+    delay_cycles<CAS_DELAY>();
+  }
+  PORTC = CTRL_DEFAULT;
+  return first != READ || second != READ;
+}
+
+// Approximate cycles of RAS low for the read in `precharge_pair`: RCD_CYCLES,
+// then READ_CAS_CYCLES with the OUT of the next row address, but setting A8 at
+// runtime is estimated at one more than A8_CYCLES each time, as the compiler
+// may branch
+constexpr uint8_t PRECHARGE_RAS_CYCLES = RCD_CYCLES + READ_CAS_CYCLES + OUT_CYCLES + 2 * (A8_CYCLES + 1);
+
+// Loop over the 8-bit x 8-bit address range of A8 quadrant `a8` with
+// `precharge_pair`
+template <Direction DIR, Read READ, Write WRITE, uint8_t PRECHARGE>
+void march_precharge_once(uint8_t a8) {
+  uint16_t address = 0;
+  do {
+    if (DIR == DN) --address;
+    const uint8_t col = address >> 8;
+    const uint8_t row = address & 0xFF;
+    if (precharge_pair<READ, WRITE, PRECHARGE>(row, col, a8)) {
+      sweep_failed = true;
+    }
+    if (DIR == UP) ++address;
+  } while (address != 0);
+}
+
+// `march_precharge_once` over one quadrant for `march_quadrants`
+template <Direction DIR, Read READ, Write WRITE, uint8_t PRECHARGE>
+struct MarchPrechargeOnce {
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() { march_precharge_once<DIR, READ, WRITE, PRECHARGE>(quadrant(ROW_A8, COL_A8)); }
+};
+
+// Perform one step of march algorithm with `precharge_pair`
+template <Chip CHIP, Direction DIR, Read READ, Write WRITE, uint8_t PRECHARGE>
+void march_precharge_step() {
+  // Data is same for all writes, so set Din once outside loop
+  set_data<WRITE>();
+
+  march_quadrants<CHIP, DIR>(MarchPrechargeOnce<DIR, READ, WRITE, PRECHARGE>());
+}
+
+// Run march C- with every read followed by a write (or a second read, for
+// the last element) after only PRECHARGE + 1 cycles of RAS high
+// Returns true if it passed
+template <Chip CHIP, uint8_t PRECHARGE>
+bool march_c_precharge() {
+  sweep_failed = false;
+  march_step<CHIP, UP, W0>();
+  march_precharge_step<CHIP, UP, R0, W1, PRECHARGE>();
+  march_precharge_step<CHIP, UP, R1, W0, PRECHARGE>();
+  march_precharge_step<CHIP, DN, R0, W1, PRECHARGE>();
+  march_precharge_step<CHIP, DN, R1, W0, PRECHARGE>();
+  march_precharge_step<CHIP, DN, R0, WX, PRECHARGE>();
+  return !sweep_failed;
+}
+
+// Precharge sweep for `step_down`, returning cycles of RAS high
+template <Chip CHIP>
+struct PrechargeSweep {
+  template <uint8_t PRECHARGE>
+  static uint8_t run() { return march_c_precharge<CHIP, PRECHARGE>() ? PRECHARGE + 1 : 0; }
+};
+
+// Find the shortest RAS precharge (tRP) the chip passes march C- with, and
+// the approximate read cycle time (tRC) that gives, stepping down from
+// PRECHARGE_TEST to 0 cycles of delay
+template <Chip CHIP>
+void test_precharge() {
+  const StepDown rp = step_down<PrechargeSweep<CHIP>, PRECHARGE_TEST, 0>();
+  serial_begin();
+  serial_print_P(PSTR("PRECHARGE"));
+  serial_field_P(PSTR("rp_ns"), cycles_to_ns(rp.result));
+  serial_field_P(PSTR("approx_rc_ns"), rp.result == 0 ? 0 : cycles_to_ns(PRECHARGE_RAS_CYCLES + rp.result));
+  serial_field_P(PSTR("start_ns"), cycles_to_ns(PRECHARGE_TEST + 1));
+  serial_field_P(PSTR("limit"), rp.limit);
+  serial_end();
+}
+
+// Read cycle at `row`, `col` sampling Dout `DELAY` cycles after CAS, with A8
+// and Din for the row and col strobes already in `portb_row` and `portb_col`
+// A8 is set by a single OUT in both halves, so RAS to CAS takes the same
+// cycles in every quadrant (SPEED_RCD_CYCLES, one more than `read` without A8)
+template <uint8_t DELAY>
+Read speed_read(uint8_t row, uint8_t col, uint8_t portb_row, uint8_t portb_col) {
+  PORTD = row;
+  PORTB = portb_row;
+  PORTC = CTRL_READ_ROW;
+  PORTD = col;
+  PORTB = portb_col;
+  PORTC = CTRL_READ_COL;
+  delay_cycles<DELAY>();
+  const Read result = Read(PINB & DOUT);
+  PORTC = CTRL_DEFAULT;
+  return result;
+}
+
+// Write cycle at `row`, `col` like `speed_read`, timed by SPEED_RCD_CYCLES and
+// WRITE_CAS_CYCLES
+void speed_write(uint8_t row, uint8_t col, uint8_t portb_row, uint8_t portb_col) {
+  PORTD = row;
+  PORTB = portb_row;
+  PORTC = CTRL_WRITE_ROW;
+  PORTD = col;
+  PORTB = portb_col;
+  PORTC = CTRL_WRITE_COL;
+  delay_cycles<CAS_DELAY>();
+  PORTC = CTRL_DEFAULT;
+}
+
+// Loop over the 8-bit x 8-bit address range of A8 quadrant `a8`, up or down,
+// like `march_once` but sampling Dout `DELAY` cycles after CAS
+// A8 quadrant is row A8 | col A8 << 1, as in `march_precharge_once`
+// Data is the row stripe background, flipped on odd rows, so Dout toggles at
+// every read in row-fast order: with the Dout pull-up off, a floating pin
+// keeps the last level, and a read sampled too early would pass on solid data
+template <Direction DIR, Read READ, Write WRITE, uint8_t DELAY>
+void march_speed_once(uint8_t a8) {
+  const uint8_t portb = PORTB & ~(A8 | DIN);
+  const uint8_t portb_row = portb | ((a8 & 0x01) != 0 ? A8 : 0);
+  const uint8_t portb_col = portb | ((a8 & 0x02) != 0 ? A8 : 0);
+  uint16_t address = 0;
+  do {
+    if (DIR == DN) --address;
+    const uint8_t col = address >> 8;
+    const uint8_t row = address & 0xFF;
+    const bool flip = (row & 0x01) != 0;
+    if (READ != RX) {
+      // R1 is the Dout bit, so flip expected value with xor
+      const Read expected = flip ? Read(READ ^ DOUT) : READ;
+      if (speed_read<DELAY>(row, col, portb_row, portb_col) != expected) {
+        sweep_failed = true;
+      }
+    }
+    if (WRITE != WX) {
+      const uint8_t din = flip == (WRITE == W0) ? DIN : 0;
+      speed_write(row, col, portb_row | din, portb_col | din);
+    }
+    if (DIR == UP) ++address;
+  } while (address != 0);
+}
+
+// `march_speed_once` over one quadrant for `march_quadrants`
+template <Direction DIR, Read READ, Write WRITE, uint8_t DELAY>
+struct MarchSpeedOnce {
+  template <Bit ROW_A8, Bit COL_A8>
+  void run() { march_speed_once<DIR, READ, WRITE, DELAY>(quadrant(ROW_A8, COL_A8)); }
+};
+
+// Perform one step of march algorithm sampling Dout `DELAY` cycles after CAS
+template <Chip CHIP, Direction DIR, Read READ, Write WRITE, uint8_t DELAY>
+void march_speed_step() {
+  march_quadrants<CHIP, DIR>(MarchSpeedOnce<DIR, READ, WRITE, DELAY>());
+}
+
+// Run march C- over the row stripe background sampling Dout `DELAY` cycles
+// after CAS
+// Returns true if it passed
+template <Chip CHIP, uint8_t DELAY>
+bool march_c_speed() {
+  sweep_failed = false;
+  march_speed_step<CHIP, UP, RX, W0, DELAY>();
+  march_speed_step<CHIP, UP, R0, W1, DELAY>();
+  march_speed_step<CHIP, UP, R1, W0, DELAY>();
+  march_speed_step<CHIP, DN, R0, W1, DELAY>();
+  march_speed_step<CHIP, DN, R1, W0, DELAY>();
+  march_speed_step<CHIP, DN, R0, WX, DELAY>();
+  return !sweep_failed;
+}
+
+// Read delay sweep for `step_down`, returning the delay
+template <Chip CHIP>
+struct SpeedSweep {
+  template <uint8_t DELAY>
+  static uint8_t run() { return march_c_speed<CHIP, DELAY>() ? DELAY : 0; }
+};
+
+// RAS to Dout sample in cycles for `speed_read` with `delay`, counted like
+// SPEED_RCD_CYCLES and CAC_CYCLES
+constexpr uint8_t speed_rac_cycles(uint8_t delay) {
+  return SPEED_RCD_CYCLES + delay + OUT_CYCLES - IN_LATENCY_CYCLES;
+}
+
+// Standard speed grades by tRAC in ns (4164-10 to 4164-20, same for 41256)
+const uint8_t SPEED_GRADES[] = { 100, 120, 150, 200 };
+// Reported grade if the earliest read that passed is slower than every grade,
+// which the tester's own strobe timing can cause, so 0 still means failed
+constexpr uint16_t SPEED_UNGRADED = 0xFFFF;
+
+// Bin the chip by the earliest Dout sample that passes all of march C-,
+// stepping down from READ_DELAY to 1 cycle, reported as time from CAS (tCAC)
+// and RAS (tRAC) and the fastest standard speed grade that fits (or
+// SPEED_UNGRADED)
+template <Chip CHIP>
+void test_speed() {
+  const StepDown speed = step_down<SpeedSweep<CHIP>, READ_DELAY, 1>();
+  const uint8_t delay = speed.result;
+  const uint16_t rac_ns = delay == 0 ? 0 : cycles_to_ns(speed_rac_cycles(delay));
+  uint16_t grade = 0;
+  if (delay != 0) {
+    grade = SPEED_UNGRADED;
+    for (uint8_t i = sizeof(SPEED_GRADES); i-- != 0;) {
+      if (SPEED_GRADES[i] >= rac_ns) grade = SPEED_GRADES[i];
+    }
+  }
+  serial_begin();
+  serial_print_P(PSTR("SPEED"));
+  serial_field_P(PSTR("delay"), delay);
+  serial_field_P(PSTR("cac_ns"), delay == 0 ? 0 : cycles_to_ns(delay - 1));
+  serial_field_P(PSTR("rac_ns"), rac_ns);
+  serial_field_P(PSTR("grade_ns"), grade);
+  serial_field_P(PSTR("limit"), speed.limit);
+  serial_end();
+}
+
+// Fault log of recent test sessions, kept in EEPROM through reset and power loss
+// Each session takes the slot after the newest record to spread wear
+constexpr uint8_t LOG_SIZE = 24;
+// Passes between updates to the record (also updated on the first failure)
+constexpr uint8_t LOG_INTERVAL = 16;
+constexpr uint16_t LOG_ERASED = 0xFFFF;
+constexpr uint8_t LOG_SCREEN = 0x80;
+
+struct LogRecord {
+  uint16_t session; // LOG_ERASED if unused
+  uint8_t chip; // Chip
+  uint8_t algorithm; // Algorithm, plus LOG_SCREEN in screening mode
+  uint16_t rac_ns; // slowest diagonal access at session start
+  Stats stats;
+};
+
+LogRecord EEMEM fault_log[LOG_SIZE];
+
+// Record of current session and its slot in `fault_log`
+LogRecord log_record;
+uint8_t log_slot;
+
+// Find slot of newest record, or LOG_SIZE if log is empty
+uint8_t log_newest() {
+  uint8_t newest = LOG_SIZE;
+  uint16_t newest_session = 0;
+  for (uint8_t slot = 0; slot < LOG_SIZE; ++slot) {
+    const uint16_t session = eeprom_read_word(&fault_log[slot].session);
+    if (session == LOG_ERASED) continue;
+    // Session numbers wrap around
+    if (newest == LOG_SIZE || int16_t(session - newest_session) > 0) {
+      newest = slot;
+      newest_session = session;
+    }
+  }
+  return newest;
+}
+
+// Copy statistics into the current record
+// NOTE EEPROM writes are slow, so only call between passes
+void log_update() {
+  log_record.stats = stats;
+  eeprom_update_block(&log_record, &fault_log[log_slot], sizeof(LogRecord));
+}
+
+// Start a new record after the newest one
+void log_begin(Chip chip, uint16_t rac_ns) {
+  const uint8_t newest = log_newest();
+  uint16_t session = 0;
+  log_slot = 0;
+  if (newest != LOG_SIZE) {
+    session = eeprom_read_word(&fault_log[newest].session) + 1;
+    if (session == LOG_ERASED) session = 0;
+    log_slot = newest + 1 == LOG_SIZE ? 0 : newest + 1;
+  }
+  log_record = LogRecord {
+    session, chip, uint8_t(settings.algorithm | (SCREEN_MODE ? LOG_SCREEN : 0)), rac_ns, Stats {},
+  };
+  log_update();
+}
+
+// Send the new session's record number, chip and sampled access time
+void report_session() {
+  serial_begin();
+  serial_print_P(PSTR("SESSION"));
+  serial_field_P(PSTR("session"), log_record.session);
+  serial_field_P(PSTR("chip"), part_number(Chip(log_record.chip)));
+  serial_field_P(PSTR("rac_ns"), log_record.rac_ns);
+  serial_end();
+}
+
+// Send all records in the fault log, oldest first
+void log_dump() {
+  const uint8_t newest = log_newest();
+  if (newest == LOG_SIZE) return;
+  serial_begin();
+  uint8_t slot = newest;
+  do {
+    if (++slot == LOG_SIZE) slot = 0;
+    LogRecord record;
+    eeprom_read_block(&record, &fault_log[slot], sizeof(LogRecord));
+    if (record.session == LOG_ERASED) continue;
+    serial_print_P(PSTR("LOG"));
+    serial_field_P(PSTR("session"), record.session);
+    serial_field_P(PSTR("chip"), part_number(Chip(record.chip)));
+    serial_field_P(PSTR("algorithm"), record.algorithm & ~LOG_SCREEN);
+    serial_field_P(PSTR("screen"), (record.algorithm & LOG_SCREEN) != 0);
+    serial_field_P(PSTR("rac_ns"), record.rac_ns);
+    report_stats_fields(record.stats);
+    serial_write('\n');
+  } while (slot != newest);
+  serial_end();
+}
+
+// Time to listen for the host between passes
+// The host sends newlines until it sees SHELL, so a few characters' time is enough
+constexpr uint16_t SHELL_WINDOW_MS = 5;
+// Go back to testing if the host sends nothing for this long
+constexpr uint16_t SHELL_TIMEOUT_MS = 10000;
+constexpr uint8_t SHELL_LINE = 24;
+
+// Send settings as report fields
+void report_settings_fields() {
+  serial_field_P(PSTR("algorithm"), settings.algorithm);
+  serial_field_P(PSTR("chip"), settings.chip);
+  serial_field_P(PSTR("passes"), settings.passes);
+  serial_field_P(PSTR("pause_ms"), settings.pause_ms);
+  serial_field_P(PSTR("format"), settings.format);
+}
+
+// Change a setting with "name value"; returns false if not understood
+bool set_setting(char* line) {
+  char* arg = strchr(line, ' ');
+  if (arg == nullptr) return false;
+  *arg++ = '\0';
+  char* end;
+  const uint32_t value = strtoul(arg, &end, 10);
+  if (end == arg || *end != '\0') return false;
+  if (strcmp_P(line, PSTR("algorithm")) == 0 && value <= TIERED_MARCH_B) {
+    settings.algorithm = Algorithm(value);
+  } else if (strcmp_P(line, PSTR("chip")) == 0 &&
+      (value == 0 || value == part_number(DRAM_4164) || value == part_number(DRAM_41256))) {
+    settings.chip = value;
+  } else if (strcmp_P(line, PSTR("passes")) == 0 && value <= 0xFFFF) {
+    settings.passes = value;
+  } else if (strcmp_P(line, PSTR("pause")) == 0 && value <= 0xFFFF) {
+    settings.pause_ms = value;
+  } else if (strcmp_P(line, PSTR("format")) == 0 && value <= BRIEF) {
+    settings.format = Format(value);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Run commands from the host until `run`, or until it goes quiet unless `wait`
+// Commands are "settings", a setting with "name value", "measure" and "run"
+// Each line sent ends with a newline, so the host can wait for whole lines
+// Returns true if a new session should start with the new settings
+// NOTE call between `serial_begin` + `serial_listen` and `serial_end`
+bool run_shell(bool wait) {
+  serial_print_P(PSTR("SHELL\n"));
+  bool changed = false;
+  char line[SHELL_LINE];
+  while (serial_read_line(line, SHELL_LINE, wait ? 0 : SHELL_TIMEOUT_MS)) {
+    // Skip newlines the host sent to get our attention
+    if (line[0] == '\0') continue;
+    if (strcmp_P(line, PSTR("run")) == 0) {
+      return true;
+    } else if (strcmp_P(line, PSTR("measure")) == 0) {
+      serial_end();
+      measure_rac();
+    } else if (strcmp_P(line, PSTR("settings")) == 0) {
+      serial_print_P(PSTR("SETTINGS"));
+      report_settings_fields();
+    } else if (set_setting(line)) {
+      changed = true;
+      serial_print_P(PSTR("OK"));
+    } else {
+      serial_print_P(PSTR("ERROR"));
+    }
+    serial_write('\n');
+  }
+  return changed;
+}
+
+// Listen briefly for the host, entering the shell if it calls
+// Returns true if a new session should start with the new settings
+bool poll_shell() {
+  serial_begin();
+  serial_listen();
+  const bool restart = serial_read(SHELL_WINDOW_MS) >= 0 && run_shell(false);
+  serial_end();
+  return restart;
+}
+
+// Wait in the shell once the session has run `settings.passes` passes
+void end_session() {
+  serial_begin();
+  serial_listen();
+  serial_print_P(PSTR("DONE"));
+  serial_field_P(PSTR("passes"), stats.passes);
+  serial_write('\n');
+  run_shell(true);
+  serial_end();
+}
+
+// Run test algorithm in a loop
+// LED turns green after first success, but stays red after first failure
+// Returns to start a new session when the shell changes settings
+template <Chip CHIP>
+void march() {
+  for (;;) {
+    const uint32_t start = stopwatch_ticks();
+    run_pass<CHIP>();
+    const uint32_t ms = ticks_to_ms(stopwatch_ticks() - start);
+    pass();
+    count_pass();
+    count_pass_time<CHIP>(ms);
+    // Limit EEPROM wear during long soak tests
+    if ((pass_failed && stats.failed_passes == 1) || stats.passes % LOG_INTERVAL == 0) {
+      log_update();
+    }
+    if (settings.format == FULL) {
+      if (pass_failed) report_fail_map();
+      if (MOVI_MODE) report_movi<CHIP>();
+      report_pass_times<CHIP>();
+    }
+    report_stats();
+    // Log the final stats of a session, however short
+    if (settings.passes != 0 && stats.passes >= settings.passes) {
+      log_update();
+      end_session();
+      return;
+    }
+    // The shell is only polled here, so the march loop doesn't pay for it
+    if (poll_shell()) {
+      log_update();
+      return;
+    }
+  }
+}
+
+// Run `passes` passes, aborting at the first failure, and set the verdict on the LEDs
+template <Chip CHIP>
+void screen_passes(uint8_t passes) {
+  if (setjmp(abort_point) == 0) {
+    abort_on_fail = true;
+    for (uint8_t i = 0; i < passes; ++i) run_pass<CHIP>();
+    pass();
+  }
+  abort_on_fail = false;
+  // End error pulse left by an aborted read
+  PORTC = CTRL_DEFAULT;
+  if (FAIL_STREAM) flush_stream();
+}
+
+// Send verdict with time to verdict, and the failure bitmap if it failed
+void report_verdict(Chip chip, uint32_t us) {
+  serial_begin();
+  serial_print_P(is_failed() ? PSTR("VERDICT result=FAIL") : PSTR("VERDICT result=PASS"));
+  serial_field_P(PSTR("chip"), part_number(chip));
+  serial_field_P(PSTR("us"), us);
+  if (stats.failed_reads != 0) report_cell_P(PSTR("first"), stats.first_fail);
+  serial_end();
+  if (pass_failed) report_fail_map();
+}
+
+// Name of `check_socket` result
+const char* socket_name_P(Socket socket) {
+  switch (socket) {
+  case EMPTY: return PSTR("EMPTY");
+  case MISINSERTED: return PSTR("MISINSERTED");
+  case DEAD: return PSTR("DEAD");
+  default: return PSTR("OK");
+  }
+}
+
+// Send verdict for a chip that can't be tested
+void report_socket(Socket socket, uint32_t us) {
+  serial_begin();
+  serial_print_P(PSTR("VERDICT result="));
+  serial_print_P(socket_name_P(socket));
+  serial_field_P(PSTR("us"), us);
+  serial_end();
+}
+
+// Run test once for go/no-go screening, aborting at the first failure
+// Verdict stays on the LEDs until reset; time to verdict is sent over serial
+template <Chip CHIP>
+[[noreturn]] void screen() {
+  stopwatch_start();
+  screen_passes<CHIP>(1);
+  const uint32_t us = stopwatch_us();
+  count_pass();
+  log_update();
+  report_verdict(CHIP, us);
+
+  for (;;) {}
+}
+
+// Test chips placed by an automated handler, one per START signal
+// BUSY goes high when START is seen and low once PASS (LED_G) or FAIL (LED_R)
+// is valid; the verdict holds until the next START
+// Setup and logging are left out of the time to verdict, which is sent after
+[[noreturn]] void fixture() {
+  for (;;) {
+    while (!is_started()) poll_refresh();
+    stopwatch_start();
+    PORTB = (PORTB | BUSY) & ~(LED_G | LED_R);
+    memset(&stats, 0, sizeof(Stats));
+    init_dram();
+    start_refresh();
+    const Socket socket = check_socket();
+    if (socket != SOCKET_OK) {
+      fail();
+      PORTC = CTRL_DEFAULT;
+      PORTB &= ~BUSY;
+      report_socket(socket, stopwatch_us());
+    } else {
+      const Chip chip = is_41256() ? DRAM_41256 : DRAM_4164;
+      if (chip == DRAM_41256) {
+        screen_passes<DRAM_41256>(FIXTURE_MODE);
+      } else {
+        screen_passes<DRAM_4164>(FIXTURE_MODE);
+      }
+      PORTB &= ~BUSY;
+      const uint32_t us = stopwatch_us();
+      count_pass();
+      report_verdict(chip, us);
+    }
+    // Wait for handler to release START before taking the next chip
+    while (is_started()) poll_refresh();
+  }
+}
+
+// Test chip for one session, logging it to EEPROM
+template <Chip CHIP>
+void test() {
+  PORTB &= ~(LED_G | LED_R);
+  memset(&stats, 0, sizeof(Stats));
+  memset(&pass_times, 0, sizeof(PassTimes));
+  log_begin(CHIP, sample_rac());
+  report_session();
+  // Timer1 is free once the access time is sampled
+  stopwatch_start();
+  detect_access<CHIP>();
+  if (CBR_TEST) test_cbr_counter<CHIP>();
+  if (PRECHARGE_TEST) test_precharge<CHIP>();
+  if (SPEED_BIN) test_speed<CHIP>();
+  if (SCREEN_MODE) screen<CHIP>();
+  march<CHIP>();
+}
+
+int main() {
   config();
+  log_dump();
   init_dram();
+  start_refresh();
+  poll_shell();
+
+  if (FIXTURE_MODE) fixture();
 
   if (is_measure_mode()) {
     // Loop forever
     measure_rac();
   }
 
-  if (is_41256()) {
-    march<DRAM_41256>();
-  } else {
-    march<DRAM_4164>();
+  // Don't run a full pass on an empty socket or a misinserted chip
+  stopwatch_start();
+  const Socket socket = check_socket();
+  if (socket != SOCKET_OK) {
+    fail();
+    PORTC = CTRL_DEFAULT;
+    report_socket(socket, stopwatch_us());
+    for (;;) {}
+  }
+
+  for (;;) {
+    const bool is_256 = settings.chip == 0 ? is_41256() : settings.chip == part_number(DRAM_41256);
+    if (is_256) {
+      test<DRAM_41256>();
+    } else {
+      test<DRAM_4164>();
+    }
   }
 }
@@ -0,0 +1,103 @@
+// Copyright (c) 2023 Trevor Makes
+
+#pragma once
+
+#include "util.hpp"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <util/delay.h>
+
+// NOTE TXD and RXD share PD1 and PD0 with address lines A1 and A0, so the
+// USART may only be enabled while the DRAM is idle (e.g. between passes).
+// The host also sees garbage while A1 toggles, so each report starts on a
+// fresh line after an idle gap and hosts should ignore lines they can't parse.
+
+constexpr uint32_t SERIAL_BAUD = 115200;
+constexpr uint8_t SERIAL_TXD = bit_mask(1); // PD1
+
+// Write byte, waiting for room in the transmit buffer
+void serial_write(char c) {
+  while ((UCSR0A & bit_mask(UDRE0)) == 0) {}
+  // Clear transmit complete flag before queueing more data
+  UCSR0A |= bit_mask(TXC0);
+  UDR0 = c;
+}
+
+// Take over PD1 as TXD and start a new line on the host
+void serial_begin() {
+  // Double-speed mode for less baud rate error at 16 MHz
+  UBRR0 = (F_CPU / 8 + SERIAL_BAUD / 2) / SERIAL_BAUD - 1;
+  UCSR0A = bit_mask(U2X0);
+  UCSR0C = bit_mask(UCSZ01, UCSZ00); // 8N1
+  // Idle high for two frames so the host resyncs after address bus noise
+  PORTD |= SERIAL_TXD;
+  _delay_us(20000000.0 / SERIAL_BAUD);
+  UCSR0B = bit_mask(TXEN0);
+  serial_write('\n');
+}
+
+// End line, wait for transmission to finish and return PD1 to the address bus
+void serial_end() {
+  serial_write('\n');
+  while ((UCSR0A & bit_mask(TXC0)) == 0) {}
+  UCSR0B = 0;
+}
+
+// Also take over PD0 as RXD, after `serial_begin`
+// Bytes sent by the host while the receiver is off are lost
+void serial_listen() {
+  while ((UCSR0A & bit_mask(RXC0)) != 0) (void)UDR0;
+  UCSR0B |= bit_mask(RXEN0);
+}
+
+// Read byte, waiting up to `timeout_ms` (or forever if 0)
+// Returns -1 on timeout
+int16_t serial_read(uint16_t timeout_ms) {
+  for (uint32_t i = uint32_t(timeout_ms) * 100; timeout_ms == 0 || i != 0; --i) {
+    if ((UCSR0A & bit_mask(RXC0)) != 0) return UDR0;
+    _delay_us(10);
+  }
+  return -1;
+}
+
+// Read line into `line`, dropping characters past `size - 1`
+// Returns false if no byte arrived within `timeout_ms` (or forever if 0)
+bool serial_read_line(char* line, uint8_t size, uint16_t timeout_ms) {
+  uint8_t length = 0;
+  for (;;) {
+    const int16_t c = serial_read(timeout_ms);
+    if (c < 0) return false;
+    if (c == '\n' || c == '\r') break;
+    if (length + 1 < size) line[length++] = c;
+  }
+  line[length] = '\0';
+  return true;
+}
+
+// Write null-terminated string from program memory
+void serial_print_P(const char* str) {
+  for (char c; (c = pgm_read_byte(str)) != '\0'; ++str) {
+    serial_write(c);
+  }
+}
+
+// Write unsigned value in decimal
+void serial_print(uint32_t value) {
+  char digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (count != 0) serial_write(digits[--count]);
+}
+
+// Write " key=value" report field
+void serial_field_P(const char* key, uint32_t value) {
+  serial_write(' ');
+  serial_print_P(key);
+  serial_write('=');
+  serial_print(value);
+}
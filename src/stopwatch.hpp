@@ -0,0 +1,57 @@
+// Copyright (c) 2023 Trevor Makes
+
+#pragma once
+
+#include "util.hpp"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdint.h>
+
+// Timer1 overflows, extending the count to 32 bits
+volatile uint16_t stopwatch_overflows;
+
+ISR(TIMER1_OVF_vect) {
+  ++stopwatch_overflows;
+}
+
+// Start counting Timer1 ticks at F_CPU / 1024 (64us at 16 MHz)
+// NOTE shares Timer1 with access time measurement; don't mix the two
+void stopwatch_start() {
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  stopwatch_overflows = 0;
+  TIFR1 = bit_mask(TOV1);
+  TIMSK1 = bit_mask(TOIE1);
+  TCCR1B = bit_mask(CS12, CS10); // set 1024 prescaler (starts timer)
+  sei();
+}
+
+// Get ticks since `stopwatch_start`
+uint32_t stopwatch_ticks() {
+  const uint8_t sreg = SREG;
+  cli();
+  const uint16_t count = TCNT1;
+  uint16_t overflows = stopwatch_overflows;
+  // Count an overflow that happened since interrupts were disabled
+  if ((TIFR1 & bit_mask(TOV1)) != 0 && count < 0x8000) ++overflows;
+  SREG = sreg;
+  return uint32_t(overflows) << 16 | count;
+}
+
+// Get microseconds since `stopwatch_start`, good for ~4 minutes
+uint32_t stopwatch_us() {
+  return (stopwatch_ticks() << 10) / (F_CPU / 1000000);
+}
+
+// Convert ticks to milliseconds, good for ~4 hours
+constexpr uint32_t ticks_to_ms(uint32_t ticks) {
+  // ticks * 1024 * 1000 / F_CPU, without overflowing
+  return (ticks << 4) / (F_CPU / 64000);
+}
+
+// Get milliseconds since `stopwatch_start`
+uint32_t stopwatch_ms() {
+  return ticks_to_ms(stopwatch_ticks());
+}
@@ -22,3 +22,24 @@ constexpr uint8_t bit_mask(N n) { return 1 << n; }
 // Convert multiple bit indices to mask
 template <typename N, typename... ARGS>
 constexpr uint8_t bit_mask(N n, ARGS... args) { return bit_mask(n) | bit_mask(args...); }
+
+// Taps of 16-bit maximal length Galois LFSR (x^16 + x^14 + x^13 + x^11 + 1)
+constexpr uint16_t LFSR16_TAPS = 0xB400;
+
+// Step 16-bit LFSR through all nonzero values
+inline uint16_t lfsr16_next(uint16_t state) {
+  return (state & 1) != 0 ? (state >> 1) ^ LFSR16_TAPS : state >> 1;
+}
+
+// Step 16-bit LFSR backwards, undoing `lfsr16_next`
+inline uint16_t lfsr16_prev(uint16_t state) {
+  return (state & 0x8000) != 0 ? (state ^ LFSR16_TAPS) << 1 | 1 : state << 1;
+}
+
+// Taps of 32-bit maximal length Galois LFSR (x^32 + x^22 + x^2 + x + 1)
+constexpr uint32_t LFSR32_TAPS = 0x80200003;
+
+// Step 32-bit LFSR through all nonzero values
+inline uint32_t lfsr32_next(uint32_t state) {
+  return (state & 1) != 0 ? (state >> 1) ^ LFSR32_TAPS : state >> 1;
+}
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+# Copyright (c) 2023 Trevor Makes
+
+"""Draw a die map of failing cells streamed by the DRAM tester.
+
+Reads the "F element,row,col,length" lines sent with FAIL_STREAM, from a raw
+capture of tester output or one chip (--index) of a JSON file written by
+dram_host.py, and writes an image with one pixel per cell (rows down, cols
+across), coloured by the march element that first failed each cell:
+
+    tools/die_map.py capture.txt map.png --scale 2
+    tools/die_map.py lot.json chip3.png --index 3
+
+Addresses are drawn in order unless a layout file gives the physical position
+of each row and col address, e.g. {"rows": [0, 2, 1, 3, ...], "cols": [...]}
+from the die's address scrambling.
+
+Writes PNG or binary PPM by file extension, with only the Python standard
+library.
+"""
+
+import argparse
+import json
+import struct
+import sys
+import zlib
+
+from dram_host import parse_report
+
+# Colour of each march element, repeating after the last
+PALETTE = (
+    (230, 25, 75), (60, 180, 75), (255, 225, 25), (0, 130, 200),
+    (245, 130, 48), (145, 30, 180), (70, 240, 240), (240, 50, 230),
+    (210, 245, 60), (250, 190, 212), (0, 128, 128), (170, 110, 40),
+)
+BACKGROUND = (0, 0, 0)
+
+# Reports that end a pass, for picking one pass out of a soak test
+PASS_END = ('STATS', 'VERDICT')
+
+
+def read_records(path, index=None, lot=None):
+    """Return report records from a capture, or from one chip of a
+    dram_host.py JSON file (picked by `index` and `lot` if it has several)"""
+    with open(path, 'rb') as file:
+        data = file.read()
+    if data.lstrip().startswith(b'['):
+        results = json.loads(data)
+        if index is not None:
+            results = [result for result in results if result.get('index') == index]
+        if lot is not None:
+            results = [result for result in results if result.get('lot') == lot]
+        if not results:
+            raise SystemExit('no chip in %s matches --index/--lot' % path)
+        if len(results) > 1:
+            raise SystemExit('%s has %d chips; pick one with --index (and --lot)'
+                             % (path, len(results)))
+        return results[0]['records']
+    records = []
+    for raw in data.splitlines():
+        record = parse_report(raw.decode('latin-1').strip('\r'))
+        if record:
+            records.append(record)
+    return records
+
+
+def collect_fails(records, pass_number=None):
+    """Return chip part number and {(row, col): element} of first failures"""
+    chip = None
+    cells = {}
+    current = 1
+    for record in records:
+        tag = record['tag']
+        if tag in ('SESSION', 'VERDICT') and 'chip' in record:
+            chip = int(record['chip'])
+        if tag == 'F' and pass_number in (None, current):
+            for value in record.get('values', []):
+                element, row, col, length = (int(field) for field in value.split(','))
+                for offset in range(length):
+                    cells.setdefault((row + offset, col), element)
+        if tag in PASS_END:
+            current += 1
+    return chip, cells
+
+
+def load_layout(path, size):
+    """Return physical row and col position of each address"""
+    order = list(range(size))
+    if not path:
+        return order, order
+    with open(path) as file:
+        layout = json.load(file)
+    rows = layout.get('rows', order)
+    cols = layout.get('cols', order)
+    if sorted(rows) != order or sorted(cols) != order:
+        raise SystemExit('layout must place each of %d rows and cols exactly once' % size)
+    return rows, cols
+
+
+def render(cells, size, rows, cols, scale):
+    """Return image as rows of RGB bytes"""
+    pixels = [bytearray(BACKGROUND * size) for _ in range(size)]
+    for (row, col), element in cells.items():
+        if row >= size or col >= size:
+            continue
+        x, y = cols[col], rows[row]
+        pixels[y][x * 3:x * 3 + 3] = bytes(PALETTE[(element - 1) % len(PALETTE)])
+    lines = []
+    for line in pixels:
+        wide = bytearray()
+        for x in range(size):
+            wide += line[x * 3:x * 3 + 3] * scale
+        lines.extend([bytes(wide)] * scale)
+    return lines
+
+
+def write_ppm(path, lines):
+    with open(path, 'wb') as file:
+        file.write(b'P6\n%d %d\n255\n' % (len(lines[0]) // 3, len(lines)))
+        for line in lines:
+            file.write(line)
+
+
+def write_png(path, lines):
+    def chunk(kind, data):
+        body = kind + data
+        return struct.pack('>I', len(data)) + body + struct.pack('>I', zlib.crc32(body))
+
+    header = struct.pack('>IIBBBBB', len(lines[0]) // 3, len(lines), 8, 2, 0, 0, 0)
+    raw = b''.join(b'\0' + line for line in lines)  # filter type 0 per line
+    with open(path, 'wb') as file:
+        file.write(b'\x89PNG\r\n\x1a\n')
+        file.write(chunk(b'IHDR', header))
+        file.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+        file.write(chunk(b'IEND', b''))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='captured tester output or dram_host.py JSON')
+    parser.add_argument('output', help='image to write (.png or .ppm)')
+    parser.add_argument('--index', type=int,
+                        help='chip to draw from a dram_host.py JSON file (its "index")')
+    parser.add_argument('--lot', help='lot of the chip, if the JSON file has several')
+    parser.add_argument('--pass', dest='pass_number', type=int,
+                        help='only draw this pass (1-based, default all)')
+    parser.add_argument('--size', type=int, choices=(256, 512),
+                        help='rows and cols (default from the chip in the report)')
+    parser.add_argument('--layout', help='JSON file of physical row and col order')
+    parser.add_argument('--scale', type=int, default=1, help='pixels per cell (default 1)')
+    args = parser.parse_args()
+
+    records = read_records(args.input, args.index, args.lot)
+    chip, cells = collect_fails(records, args.pass_number)
+    size = args.size or (512 if chip == 41256 else 256 if chip == 4164 else
+                         512 if any(max(cell) >= 256 for cell in cells) else 256)
+    rows, cols = load_layout(args.layout, size)
+    lines = render(cells, size, rows, cols, max(args.scale, 1))
+    if args.output.lower().endswith('.png'):
+        write_png(args.output, lines)
+    else:
+        write_ppm(args.output, lines)
+
+    # Legend, since colours repeat after the palette runs out
+    counts = {}
+    for element in cells.values():
+        counts[element] = counts.get(element, 0) + 1
+    for element in sorted(counts):
+        print('element %d: %d cells, rgb%s' % (element, counts[element],
+                                               PALETTE[(element - 1) % len(PALETTE)]))
+    if not cells:
+        print('no failing cells', file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
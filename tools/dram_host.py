@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+# Copyright (c) 2023 Trevor Makes
+
+"""Test a lot of chips with the DRAM tester, recording results to CSV and JSON.
+
+For each chip, the tester is reset, given the test plan through its serial
+shell and left to run until it reports DONE (or a VERDICT in screening mode or
+for an empty socket). Results are appended with a timestamp and lot ID.
+
+    tools/dram_host.py /dev/ttyUSB0 --lot 8341 --set passes=3 --csv lot.csv
+
+Only needs the Python standard library (Linux, for termios).
+"""
+
+import argparse
+import csv
+import datetime
+import fcntl
+import json
+import os
+import re
+import select
+import struct
+import sys
+import termios
+import time
+
+# Report line: TAG followed by key=value fields or lists like "row:count"
+# Anything else is garbage from the serial pins doubling as address lines
+REPORT = re.compile(r'^([A-Z][A-Z_]*)((?: (?:[a-z_0-9]+=\w+|[0-9][0-9:,]*))*)$')
+FIELD = re.compile(r'([a-z_0-9]+)=(\w+)')
+
+# Default test plan, sent as shell commands before each chip
+DEFAULT_PLAN = {'passes': '1'}
+
+# Shell commands that change settings
+SETTINGS = ('algorithm', 'chip', 'passes', 'pause', 'format')
+
+CSV_COLUMNS = (
+    'timestamp', 'lot', 'index', 'chip', 'verdict', 'rac_ns', 'passes',
+    'failed_passes', 'failed_reads', 'first_row', 'first_col', 'min_ms',
+    'max_ms', 'mean_ms', 'budget_ms', 'slow_passes', 'verdict_us',
+)
+
+
+class TesterError(Exception):
+    pass
+
+
+class Tester:
+    """Line-oriented connection to the tester's serial port (or a pty)"""
+
+    def __init__(self, path, baud=115200):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+        speed = getattr(termios, 'B%d' % baud)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[0] = 0  # iflag: raw input
+        attrs[1] = 0  # oflag: raw output
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL | termios.HUPCL
+        attrs[3] = 0  # lflag: no echo or line editing
+        attrs[4] = attrs[5] = speed
+        attrs[6][termios.VMIN] = 0
+        attrs[6][termios.VTIME] = 0
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self.buffer = b''
+
+    def close(self):
+        os.close(self.fd)
+
+    def reset(self):
+        """Reset the Arduino by pulsing DTR (no effect on a pty)"""
+        dtr = struct.pack('I', termios.TIOCM_DTR)
+        try:
+            fcntl.ioctl(self.fd, termios.TIOCMBIC, dtr)
+            time.sleep(0.1)
+            fcntl.ioctl(self.fd, termios.TIOCMBIS, dtr)
+        except OSError:
+            pass
+        # Drop whatever the last session was still sending
+        time.sleep(0.2)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.buffer = b''
+
+    def write_line(self, line):
+        os.write(self.fd, line.encode('ascii') + b'\n')
+
+    def read_line(self, timeout):
+        """Return the next line, or None after `timeout` seconds"""
+        deadline = time.monotonic() + timeout
+        while b'\n' not in self.buffer:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None
+            if select.select([self.fd], [], [], remaining)[0]:
+                try:
+                    self.buffer += os.read(self.fd, 256)
+                except OSError:
+                    # pty stand-in went away
+                    raise TesterError('serial port closed')
+        line, self.buffer = self.buffer.split(b'\n', 1)
+        return line.decode('latin-1').strip('\r')
+
+    def call_shell(self, records, timeout):
+        """Send newlines until the tester answers SHELL
+
+        The tester only listens for a few ms between passes, so keep calling
+        """
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            os.write(self.fd, b'\n')
+            line = self.read_line(0.002)
+            while line is not None:
+                if line == 'SHELL':
+                    return
+                record = parse_report(line)
+                if record:
+                    records.append(record)
+                line = self.read_line(0)
+        raise TesterError('no SHELL prompt from tester')
+
+    def command(self, line, timeout=2.0):
+        """Send shell command and return the tester's answer"""
+        self.write_line(line)
+        deadline = time.monotonic() + timeout
+        while True:
+            answer = self.read_line(max(deadline - time.monotonic(), 0))
+            if answer is None:
+                raise TesterError('no answer to %r' % line)
+            if answer:
+                return answer
+
+
+def parse_report(line):
+    """Parse report line into a dict with its tag, or None if it isn't one"""
+    match = REPORT.match(line)
+    if not match:
+        return None
+    record = {'tag': match.group(1)}
+    values = []
+    for token in match.group(2).split():
+        field = FIELD.fullmatch(token)
+        if field:
+            record[field.group(1)] = field.group(2)
+        else:
+            values.append(token)
+    if values:
+        record['values'] = values
+    return record
+
+
+def last(records, tag):
+    """Return the last record with `tag`, or an empty dict"""
+    for record in reversed(records):
+        if record['tag'] == tag:
+            return record
+    return {}
+
+
+def test_chip(tester, plan, timeout):
+    """Run the test plan on the chip in the socket and return its records"""
+    records = []
+    tester.reset()
+    tester.call_shell(records, timeout=10.0)
+    for name, value in plan.items():
+        answer = tester.command('%s %s' % (name, value))
+        if answer != 'OK':
+            raise TesterError('%s %s: %s' % (name, value, answer))
+    tester.write_line('run')
+
+    # Collect reports until the session ends
+    deadline = time.monotonic() + timeout
+    while True:
+        line = tester.read_line(max(deadline - time.monotonic(), 0))
+        if line is None:
+            raise TesterError('timed out waiting for DONE')
+        record = parse_report(line)
+        if record is None:
+            continue
+        records.append(record)
+        if record['tag'] in ('DONE', 'VERDICT'):
+            return records
+
+
+def summarize(records):
+    """Reduce a chip's records to one row of results"""
+    session = last(records, 'SESSION')
+    verdict = last(records, 'VERDICT')
+    stats = last(records, 'STATS')
+    times = last(records, 'TIME')
+    if verdict:
+        result = verdict['result']
+    elif stats:
+        result = 'PASS' if stats.get('failed_passes') == '0' else 'FAIL'
+    else:
+        result = 'UNKNOWN'
+    return {
+        'chip': session.get('chip', verdict.get('chip', '')),
+        'verdict': result,
+        'rac_ns': session.get('rac_ns', ''),
+        'passes': stats.get('passes', ''),
+        'failed_passes': stats.get('failed_passes', ''),
+        'failed_reads': stats.get('failed_reads', ''),
+        'first_row': stats.get('first_row', verdict.get('first_row', '')),
+        'first_col': stats.get('first_col', verdict.get('first_col', '')),
+        'min_ms': times.get('min_ms', ''),
+        'max_ms': times.get('max_ms', ''),
+        'mean_ms': times.get('mean_ms', ''),
+        'budget_ms': times.get('budget_ms', ''),
+        'slow_passes': times.get('slow_passes', ''),
+        'verdict_us': verdict.get('us', ''),
+    }
+
+
+def append_csv(path, row):
+    new = not os.path.exists(path) or os.path.getsize(path) == 0
+    with open(path, 'a', newline='') as file:
+        writer = csv.DictWriter(file, fieldnames=CSV_COLUMNS, extrasaction='ignore')
+        if new:
+            writer.writeheader()
+        writer.writerow(row)
+
+
+def append_json(path, result):
+    """Add result (with all records) to the JSON list in `path`"""
+    results = []
+    if os.path.exists(path) and os.path.getsize(path) != 0:
+        with open(path) as file:
+            results = json.load(file)
+    results.append(result)
+    with open(path + '.tmp', 'w') as file:
+        json.dump(results, file, indent=2)
+    os.replace(path + '.tmp', path)
+
+
+def parse_plan(args):
+    plan = dict(DEFAULT_PLAN)
+    if args.plan:
+        with open(args.plan) as file:
+            plan.update({name: str(value) for name, value in json.load(file).items()})
+    for setting in args.set:
+        name, _, value = setting.partition('=')
+        plan[name] = value
+    for name in plan:
+        if name not in SETTINGS:
+            raise SystemExit('unknown setting %r (expected one of %s)' % (name, ', '.join(SETTINGS)))
+    if plan.get('passes') == '0':
+        raise SystemExit('passes must be nonzero so each chip finishes')
+    return plan
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port', help='serial port of the tester, e.g. /dev/ttyUSB0')
+    parser.add_argument('--lot', help='lot ID (asked for if not given)')
+    parser.add_argument('--plan', help='JSON file of settings, e.g. {"algorithm": 1, "passes": 3}')
+    parser.add_argument('--set', action='append', default=[], metavar='NAME=VALUE',
+                        help='setting to send before each chip (overrides --plan)')
+    parser.add_argument('--csv', help='append one row per chip to this CSV file')
+    parser.add_argument('--json', help='append results with all records to this JSON file')
+    parser.add_argument('--chips', type=int, help='test this many chips without prompting')
+    parser.add_argument('--timeout', type=float, default=600.0,
+                        help='seconds to wait for each chip to finish (default 600)')
+    args = parser.parse_args()
+
+    plan = parse_plan(args)
+    lot = args.lot if args.lot is not None else input('Lot ID: ').strip()
+    tester = Tester(args.port)
+    index = 0
+    try:
+        while args.chips is None or index < args.chips:
+            if args.chips is None:
+                reply = input('Insert chip %d and press Enter (q to quit): ' % (index + 1))
+                if reply.strip().lower() == 'q':
+                    break
+            index += 1
+            timestamp = datetime.datetime.now(datetime.timezone.utc).isoformat(timespec='seconds')
+            try:
+                records = test_chip(tester, plan, args.timeout)
+            except TesterError as error:
+                print('chip %d: %s' % (index, error), file=sys.stderr)
+                records = []
+            row = {'timestamp': timestamp, 'lot': lot, 'index': index}
+            row.update(summarize(records))
+            print('chip %d: %s %s' % (index, row['chip'] or '?', row['verdict']))
+            if args.csv:
+                append_csv(args.csv, row)
+            if args.json:
+                append_json(args.json, dict(row, plan=plan, records=records))
+    finally:
+        tester.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+# Copyright (c) 2023 Trevor Makes
+
+"""Stand in for the DRAM tester on a pseudo-terminal, replaying recorded output.
+
+Answers the serial shell like the firmware, then replays one recording per
+`run` command (cycling through the recordings given), for trying out host
+tools without hardware:
+
+    tools/fake_tester.py --link /tmp/ttyDRAM tools/recordings/*.txt &
+    tools/dram_host.py /tmp/ttyDRAM --lot TEST --chips 2 --csv /tmp/lot.csv
+
+Recordings are raw captures of tester output from SESSION to DONE (or VERDICT).
+"""
+
+import argparse
+import itertools
+import os
+import select
+import sys
+import time
+import tty
+
+SETTINGS = {'algorithm': 0, 'chip': 0, 'passes': 0, 'pause': 0, 'format': 0}
+PART_NUMBERS = (0, 4164, 41256)
+
+
+def answer(line, settings):
+    """Answer shell command other than `run` like the firmware"""
+    if line == 'settings':
+        return 'SETTINGS algorithm={algorithm} chip={chip} passes={passes} ' \
+            'pause_ms={pause} format={format}'.format(**settings)
+    name, _, value = line.partition(' ')
+    if name not in settings or not value.isdigit():
+        return 'ERROR'
+    value = int(value)
+    limits = {'algorithm': value <= 2, 'chip': value in PART_NUMBERS, 'format': value <= 1}
+    if not limits.get(name, value <= 0xFFFF):
+        return 'ERROR'
+    settings[name] = value
+    return 'OK'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('recordings', nargs='+', help='captured tester output to replay')
+    parser.add_argument('--link', help='also make this symlink to the pty device')
+    parser.add_argument('--delay', type=float, default=0.01,
+                        help='seconds between replayed lines (default 0.01)')
+    args = parser.parse_args()
+
+    recordings = []
+    for path in args.recordings:
+        with open(path, 'rb') as file:
+            recordings.append(file.read().splitlines(keepends=True))
+    replays = itertools.cycle(recordings)
+
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    device = os.ttyname(slave)
+    if args.link:
+        if os.path.lexists(args.link):
+            os.remove(args.link)
+        os.symlink(device, args.link)
+    print(device, flush=True)
+
+    settings = dict(SETTINGS)
+    in_shell = False
+    buffer = b''
+    try:
+        while True:
+            select.select([master], [], [])
+            buffer += os.read(master, 256)
+            while b'\n' in buffer:
+                raw, buffer = buffer.split(b'\n', 1)
+                line = raw.decode('ascii', 'replace').strip('\r')
+                if not in_shell:
+                    # Any byte gets the tester's attention between passes
+                    os.write(master, b'\nSHELL\n')
+                    in_shell = True
+                elif not line:
+                    continue
+                elif line == 'run':
+                    in_shell = False
+                    for replayed in next(replays):
+                        os.write(master, replayed)
+                        time.sleep(args.delay)
+                    # Drop anything sent while replaying, like a real tester
+                    buffer = b''
+                else:
+                    os.write(master, answer(line, settings).encode('ascii') + b'\n')
+    except (KeyboardInterrupt, OSError):
+        pass
+    finally:
+        if args.link and os.path.islink(args.link):
+            os.remove(args.link)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())